@@ -0,0 +1,246 @@
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "src/util/logger.h"
+#include "src/util/object_counter.h"
+#include "src/util/util.h"
+#include "src/world/chunk.h"
+#include "src/world/entity/ecs.h"
+#include "src/world/entity/ecs_components.h"
+#include "src/world/gen/perlin.h"
+#include "src/world/level.h"
+#include "src/world/tile.h"
+
+#define NUM_SEEDS 3
+// Perlin is timed over this many rounds of a square grid of points.
+#define PERLIN_GRID_SIZE 256
+#define PERLIN_ROUNDS 16
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+static uint64_t const SEEDS[NUM_SEEDS] = { 12345, 777, 1234567890 };
+
+// Keeps the one-by-one perlin loop from being optimized away.
+static volatile double perlin_sink;
+
+static double const time_perlin(uint64_t const seed, bool const batched);
+
+// FNV-1a over every tile, tile shape and entity position, so any change to the generated world shows up.
+static uint64_t const hash_level(level_t* const level);
+
+static uint64_t const hash_bytes(uint64_t hash, void const* const data, size_t const size);
+
+// In KiB, or 0 where the platform cannot tell.
+static size_t const get_peak_rss(void);
+
+static void print_usage(char const* const program);
+
+// Parses a whole decimal argument into *value. Returns false on anything else, leaving *value untouched.
+static bool const parse_size(char const* const str, size_t* const value);
+
+int main(int argc, char** argv) {
+    logger_set_log_level(LOG_LEVEL__WARN);
+
+    size_t args[4] = { 16, 8, 0, 3 };
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+    }
+    if (argc > 5) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (!parse_size(argv[i], &(args[i - 1]))) {
+            fprintf(stderr, "%s: invalid argument '%s'\n", argv[0], argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    size_chunks_t const width = args[0];
+    size_chunks_t const height = args[1];
+    size_t const num_threads = args[2];
+    size_t const num_runs = args[3];
+    if (width == 0 || height == 0 || num_runs == 0) {
+        fprintf(stderr, "%s: sizes and runs must be positive\n", argv[0]);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // static initialization
+    tiles_init();
+
+    printf("perlin: %.2f ns per sample one by one, %.2f ns per sample batched\n", time_perlin(SEEDS[0], false), time_perlin(SEEDS[0], true));
+
+    size_t const num_chunks = width * height * width;
+    printf("level: %zu x %zu x %zu chunks, %zu runs per seed\n", width, height, width, num_runs);
+    // Noise and fill are summed over every thread, the other stages are wall-clock.
+    printf("%12s %4s %9s %9s %9s %9s %9s %9s %9s %11s %18s\n", "seed", "run", "total ms", "gen ms", "noise ms*", "fill ms*", "smooth ms", "decor ms", "spawn ms", "chunks/s", "checksum");
+
+    size_t threads_used = 0;
+    for (size_t i = 0; i < NUM_SEEDS; i++) {
+        for (size_t run = 0; run < num_runs; run++) {
+            level_t* const level = level_new(&(level_settings_t) {
+                .size = { width, height, width },
+                .seed = SEEDS[i],
+                .num_threads = num_threads
+            });
+
+            level_gen_stats_t stats;
+            level_get_gen_stats(level, &stats);
+            threads_used = stats.num_threads;
+
+            printf("%12" PRIu64 " %4zu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %11.0f %18" PRIx64 "\n",
+                SEEDS[i], run,
+                stats.total_ns / 1e6, stats.generate_ns / 1e6, stats.noise_cpu_ns / 1e6, stats.fill_cpu_ns / 1e6,
+                stats.smooth_ns / 1e6, stats.decorate_ns / 1e6, stats.spawn_ns / 1e6,
+                num_chunks / (stats.total_ns / 1e9), hash_level(level)
+            );
+
+            level_delete(level);
+        }
+    }
+
+    printf("threads: %zu, peak RSS: %zu KiB\n", threads_used, get_peak_rss());
+
+    // static cleanup
+    tiles_cleanup();
+    chunks_cleanup();
+
+    object_counter_summarize(true);
+
+    return 0;
+}
+
+static double const time_perlin(uint64_t const seed, bool const batched) {
+    perlin_t* const perlin = perlin_new(seed);
+    double* const grid = malloc(sizeof(double) * PERLIN_GRID_SIZE * PERLIN_GRID_SIZE);
+    assert(grid != nullptr);
+
+    double sum = 0.0;
+    uint64_t const start_time = get_time_ns();
+    for (size_t round = 0; round < PERLIN_ROUNDS; round++) {
+        double const origin[2] = { round * (double) PERLIN_GRID_SIZE, 0.0 };
+        if (batched) {
+            perlin_fill_grid_2d(perlin, origin, (double[2]) { 1.0 / 64, 1.0 / 64 }, (size_t[2]) { PERLIN_GRID_SIZE, PERLIN_GRID_SIZE }, grid);
+            sum += grid[round];
+        } else {
+            for (size_t j = 0; j < PERLIN_GRID_SIZE; j++) {
+                for (size_t i = 0; i < PERLIN_GRID_SIZE; i++) {
+                    sum += perlin_get_2d(perlin, origin[0] + i / 64.0, origin[1] + j / 64.0);
+                }
+            }
+        }
+    }
+    uint64_t const elapsed = get_time_ns() - start_time;
+
+    free(grid);
+    perlin_delete(perlin);
+
+    perlin_sink = sum;
+
+    return elapsed / (double) (PERLIN_ROUNDS * PERLIN_GRID_SIZE * PERLIN_GRID_SIZE);
+}
+
+static uint64_t const hash_level(level_t* const level) {
+    size_chunks_t size[NUM_AXES];
+    level_get_size(level, size);
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    tile_t tiles[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+    tile_shape_t shapes[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+    for (size_chunks_t y = 0; y < size[AXIS__Y]; y++) {
+        for (size_chunks_t z = 0; z < size[AXIS__Z]; z++) {
+            for (size_chunks_t x = 0; x < size[AXIS__X]; x++) {
+                chunk_read_snapshot(level_get_chunk(level, (pos_chunks_t[NUM_AXES]) { (pos_chunks_t) x, (pos_chunks_t) y, (pos_chunks_t) z }), tiles, shapes, nullptr);
+                hash = hash_bytes(hash, tiles, sizeof(tiles));
+                hash = hash_bytes(hash, shapes, sizeof(shapes));
+            }
+        }
+    }
+
+    ecs_t* const ecs = level_get_ecs(level);
+    for (entity_t entity = 0; entity <= ecs_get_highest_entity_id(ecs); entity++) {
+        if (ecs_does_entity_exist(ecs, entity) && ecs_has_component(ecs, entity, ECS_COMPONENT__POS)) {
+            ecs_component_pos_t const* const pos = ecs_get_component_data(ecs, entity, ECS_COMPONENT__POS);
+            hash = hash_bytes(hash, pos->pos, sizeof(pos->pos));
+        }
+    }
+
+    return hash;
+}
+
+static uint64_t const hash_bytes(uint64_t hash, void const* const data, size_t const size) {
+    uint8_t const* const bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static size_t const get_peak_rss(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+#ifdef __APPLE__
+    // Bytes here, KiB everywhere else.
+    return (size_t) usage.ru_maxrss / 1024;
+#else
+    return (size_t) usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void print_usage(char const* const program) {
+    fprintf(stderr, "usage: %s [width] [height] [threads] [runs]\n", program);
+    fprintf(stderr, "  width, height  level size in chunks (default 16, 8)\n");
+    fprintf(stderr, "  threads        generation threads, 0 for one per core (default 0)\n");
+    fprintf(stderr, "  runs           runs per seed (default 3)\n");
+}
+
+static bool const parse_size(char const* const str, size_t* const value) {
+    assert(str != nullptr);
+    assert(value != nullptr);
+
+    // strtoul would skip leading whitespace and wrap negative numbers around.
+    if (!isdigit((unsigned char) str[0])) {
+        return false;
+    }
+
+    char* end;
+    errno = 0;
+    unsigned long const result = strtoul(str, &end, 10);
+    if (errno != 0 || *end != '\0') {
+        return false;
+    }
+
+    *value = result;
+    return true;
+}
@@ -25,11 +25,15 @@
 #include "src/render/view_type.h"
 #include "src/util/logger.h"
 #include "src/util/object_counter.h"
+#include "src/util/util.h"
 
 #define WINDOW_TITLE "rudyscung"
 #define WINDOW_INITIAL_WIDTH 800
 #define WINDOW_INITIAL_HEIGHT 600
 
+#define SLICE_DIAMETER 13
+#define SLICE_RADIUS ((SLICE_DIAMETER - 1) / 2)
+
 #define TICKS_PER_SECOND 20
 #define MS_PER_TICK (1000 / (TICKS_PER_SECOND))
 
@@ -41,6 +45,7 @@ struct client {
     renderer_t* renderer;
     view_type_t* view_type;
     level_t* level;
+    level_observer_t observer;
     entity_t player;
 };
 
@@ -211,8 +216,10 @@ static void update_slice(client_t* const self, bool const force) {
     float pos[NUM_AXES];
     camera_get_pos(camera, pos);
 
-    size_t const slice_diameter = 13;
-    size_t const slice_radius = (slice_diameter - 1) / 2;
+    level_move_observer(self->level, self->observer, pos);
+
+    size_t const slice_diameter = SLICE_DIAMETER;
+    size_t const slice_radius = SLICE_RADIUS;
 
     size_chunks_t level_size[NUM_AXES];
     level_get_size(self->level, level_size);
@@ -265,7 +272,11 @@ static void new_level(client_t* const self, size_chunks_t const size[NUM_AXES])
         view_type_delete(self->view_type);
     }
 
-    self->level = level_new(size);
+    self->level = level_new(&(level_settings_t) {
+        .size = { size[AXIS__X], size[AXIS__Y], size[AXIS__Z] },
+        .seed = (uint64_t) get_time_ms(),
+        .lazy = true
+    });
 
     ecs_t* const ecs = level_get_ecs(self->level);
 
@@ -278,6 +289,9 @@ static void new_level(client_t* const self, size_chunks_t const size[NUM_AXES])
     player_pos->pos[AXIS__Y] = 120.0f;
     player_pos->pos[AXIS__Z] = (size[AXIS__Z] / 2.0f) * CHUNK_SIZE;
 
+    // Keep one ring of columns beyond the render slice generated so crossing a chunk border rarely stalls.
+    self->observer = level_add_observer(self->level, player_pos->pos, SLICE_RADIUS + 1);
+
     player_rot->rot[ROT_AXIS__Y] = M_PI / 4 * 3;
     player_rot->rot[ROT_AXIS__X] = M_PI / 4 * 2;
 
@@ -2,6 +2,7 @@
 
 #include "src/client/client.h"
 #include "src/util/object_counter.h"
+#include "src/world/chunk.h"
 #include "src/world/tile.h"
 #include "src/util/logger.h"
 
@@ -29,6 +30,7 @@ int main(int argc, char** argv) {
 
     // static cleanup
     tiles_cleanup();
+    chunks_cleanup();
 
     object_counter_summarize(true);
 
@@ -26,28 +26,25 @@ void raycast_cast_in_level(raycast_t* const self, level_t const* const level, fl
 
     float const max_range = 10.0f;
 
-    size_t level_size[NUM_AXES];
-    level_get_size(level, level_size);
-    size_t level_size_tiles[NUM_AXES] = { level_size[AXIS__X] * CHUNK_SIZE, level_size[AXIS__Y] * CHUNK_SIZE, level_size[AXIS__Z] * CHUNK_SIZE };
-
     self->hit = false;
 
     for (float range = 0.0f; range < max_range; range += ray_scale) {
-        size_t tile_pos[NUM_AXES] = { (size_t) floorf(raypos[AXIS__X]), (size_t) floorf(raypos[AXIS__Y]), (size_t) floorf(raypos[AXIS__Z]) };
-
-        if (tile_pos[AXIS__X] < 0 || tile_pos[AXIS__Y] < 0 || tile_pos[AXIS__Z] < 0) {
-            break;
-        }
+        pos_tiles_t tile_pos[NUM_AXES] = { (pos_tiles_t) floorf(raypos[AXIS__X]), (pos_tiles_t) floorf(raypos[AXIS__Y]), (pos_tiles_t) floorf(raypos[AXIS__Z]) };
 
-        if (tile_pos[AXIS__X] >= level_size_tiles[AXIS__X] || tile_pos[AXIS__Y] >= level_size_tiles[AXIS__Y] || tile_pos[AXIS__Z] >= level_size_tiles[AXIS__Z]) {
+        if (level_is_tile_oob(level, tile_pos)) {
             break;
         }
 
-        tile_t const tile = level_get_tile(level, tile_pos);
+        chunk_t const* const chunk = level_get_chunk(level, (pos_chunks_t[NUM_AXES]) {
+            (pos_chunks_t) CHUNK_COORD(tile_pos[AXIS__X]),
+            (pos_chunks_t) CHUNK_COORD(tile_pos[AXIS__Y]),
+            (pos_chunks_t) CHUNK_COORD(tile_pos[AXIS__Z])
+        });
+        size_t const row = CHUNK_ROW(CHUNK_LOCAL(tile_pos[AXIS__Y]), CHUNK_LOCAL(tile_pos[AXIS__Z]));
 
-        if (tile != TILE__AIR) {
+        if ((chunk_get_occupancy(chunk)[row] >> CHUNK_LOCAL(tile_pos[AXIS__X])) & 1) {
             self->hit = true;
-            self->tile = tile;
+            self->tile = level_get_tile(level, tile_pos);
             self->side = SIDE__TOP;
 
             self->pos[AXIS__X] = raypos[AXIS__X];
@@ -9,7 +9,7 @@
 typedef struct raycast {
     bool hit;
     float pos[NUM_AXES];
-    size_t tile_pos[NUM_AXES];
+    pos_tiles_t tile_pos[NUM_AXES];
     tile_t tile;
     side_t side;
 } raycast_t;
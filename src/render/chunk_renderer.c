@@ -9,6 +9,7 @@
 #include "src/util/object_counter.h"
 #include "src/world/side.h"
 #include "src/world/chunk.h"
+#include "src/world/level.h"
 #include "src/render/level_renderer.h"
 #include "src/render/tessellator.h"
 #include "src/render/tile_renderer.h"
@@ -17,12 +18,16 @@ struct chunk_renderer {
     level_renderer_t* level_renderer;
     chunk_t const* chunk;
     bool ready;
+    // The chunk generation this mesh was built from.
+    uint64_t generation;
     GLuint vao;
     GLuint vbo;
     GLuint ebo;
     size_t num_elements;
 };
 
+static void get_covered_rows(chunk_renderer_t const* const self, level_t const* const level, pos_chunks_t const chunk_pos[NUM_AXES], side_t const side, chunk_row_t covered[CHUNK_SIZE * CHUNK_SIZE]);
+
 chunk_renderer_t* const chunk_renderer_new(level_renderer_t* const level_renderer, chunk_t const* const chunk) {
     assert(level_renderer != nullptr);
     assert(chunk != nullptr);
@@ -33,6 +38,7 @@ chunk_renderer_t* const chunk_renderer_new(level_renderer_t* const level_rendere
     self->level_renderer = level_renderer;
     self->chunk = chunk;
     self->ready = false;
+    self->generation = 0;
     self->num_elements = 0;
 
     // Set up arrays
@@ -77,36 +83,59 @@ bool chunk_renderer_is_ready(chunk_renderer_t const* const self) {
     return self->ready;
 }
 
+uint64_t const chunk_renderer_get_generation(chunk_renderer_t const* const self) {
+    assert(self != nullptr);
+
+    return self->generation;
+}
+
 void chunk_renderer_build(chunk_renderer_t* const self, tessellator_t* const tessellator) {
     assert(self != nullptr);
     assert(tessellator != nullptr);
 
     tessellator_bind(tessellator, self->vao, self->vbo, 0);
 
-    size_chunks_t chunk_pos[NUM_AXES];
+    pos_chunks_t chunk_pos[NUM_AXES];
     chunk_get_pos(self->chunk, chunk_pos);
 
-    bool occlusion[NUM_SIDES] = { false };
-    for (size_t x = 0; x < CHUNK_SIZE; x++) {
+    level_t const* const level = level_renderer_get_level(self->level_renderer);
+    self->generation = level_get_chunk_generation(level, chunk_pos);
+
+    // Empty chunks have nothing to draw.
+    if (!chunk_is_empty(self->chunk)) {
+        chunk_row_t covered[NUM_SIDES][CHUNK_SIZE * CHUNK_SIZE];
+        for (side_t side = 0; side < NUM_SIDES; side++) {
+            get_covered_rows(self, level, chunk_pos, side, covered[side]);
+        }
+
+        tile_t tiles[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+        tile_shape_t shapes[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+        chunk_row_t occupancy[CHUNK_SIZE * CHUNK_SIZE];
+        chunk_read_snapshot(self->chunk, tiles, shapes, occupancy);
+
+        bool occlusion[NUM_SIDES];
         for (size_t y = 0; y < CHUNK_SIZE; y++) {
             for (size_t z = 0; z < CHUNK_SIZE; z++) {
-                size_t world_pos[NUM_AXES] = {
-                    [AXIS__X] = chunk_pos[AXIS__X] * CHUNK_SIZE + x,
-                    [AXIS__Y] = chunk_pos[AXIS__Y] * CHUNK_SIZE + y,
-                    [AXIS__Z] = chunk_pos[AXIS__Z] * CHUNK_SIZE + z
-                };
+                size_t const row = CHUNK_ROW(y, z);
+
+                // Tiles covered on every side draw nothing, whatever their shape.
+                chunk_row_t hidden = (chunk_row_t) ~0;
                 for (side_t side = 0; side < NUM_SIDES; side++) {
-                    occlusion[side] = level_renderer_is_tile_side_occluded(self->level_renderer, world_pos, side);
+                    hidden &= covered[side][row];
                 }
-                size_t pos[NUM_AXES] = { x, y, z };
 
-                tile_t const tile = chunk_get_tile(self->chunk, pos);
-                tile_shape_t const tile_shape = chunk_get_tile_shape(self->chunk, pos);
+                for (chunk_row_t visible = occupancy[row] & (chunk_row_t) ~hidden; visible != 0; visible &= visible - 1) {
+                    size_t const x = (size_t) __builtin_ctz(visible);
+                    for (side_t side = 0; side < NUM_SIDES; side++) {
+                        occlusion[side] = (covered[side][row] >> x) & 1;
+                    }
 
-                int const pos_i[NUM_AXES] = { x, y, z };
-                float color[3] = { 1.0f, 1.0f, 1.0f };
+                    size_t const i = (row * CHUNK_SIZE) + x;
+                    int const pos_i[NUM_AXES] = { x, y, z };
+                    float color[3] = { 1.0f, 1.0f, 1.0f };
 
-                tile_renderer_render_tile(tessellator, pos_i, tile, tile_shape, color, occlusion);
+                    tile_renderer_render_tile(tessellator, pos_i, tiles[i], shapes[i], color, occlusion);
+                }
             }
         }
     }
@@ -126,3 +155,47 @@ void chunk_renderer_draw(chunk_renderer_t const* const self) {
     glDrawArrays(GL_TRIANGLES, 0, self->num_elements);
     glBindVertexArray(0);
 }
+
+static void get_covered_rows(chunk_renderer_t const* const self, level_t const* const level, pos_chunks_t const chunk_pos[NUM_AXES], side_t const side, chunk_row_t covered[CHUNK_SIZE * CHUNK_SIZE]) {
+    assert(self != nullptr);
+    assert(level != nullptr);
+
+    int offsets[NUM_AXES];
+    side_get_offsets(side, offsets);
+    side_t const opposite = side_get_opposite(side);
+
+    // A tile is covered on a side when its neighbour there fully covers the face back towards it.
+    chunk_row_t const* const own = chunk_get_full_faces(self->chunk, opposite);
+
+    pos_chunks_t const neighbour_pos[NUM_AXES] = { chunk_pos[AXIS__X] + offsets[AXIS__X], chunk_pos[AXIS__Y] + offsets[AXIS__Y], chunk_pos[AXIS__Z] + offsets[AXIS__Z] };
+    pos_tiles_t const neighbour_origin[NUM_AXES] = { (pos_tiles_t) neighbour_pos[AXIS__X] * CHUNK_SIZE, (pos_tiles_t) neighbour_pos[AXIS__Y] * CHUNK_SIZE, (pos_tiles_t) neighbour_pos[AXIS__Z] * CHUNK_SIZE };
+    chunk_row_t const* const neighbour = level_is_tile_oob(level, neighbour_origin) ? nullptr : chunk_get_full_faces(level_get_chunk(level, neighbour_pos), opposite);
+
+    // The level edges count as occluding, except for the sky.
+    chunk_row_t const edge = side == SIDE__TOP ? 0 : (chunk_row_t) ~0;
+
+    for (size_t y = 0; y < CHUNK_SIZE; y++) {
+        for (size_t z = 0; z < CHUNK_SIZE; z++) {
+            size_t const row = CHUNK_ROW(y, z);
+
+            // Along X the neighbours share the row, shifted by one tile.
+            if (offsets[AXIS__X] != 0) {
+                chunk_row_t const next = neighbour != nullptr ? neighbour[row] : edge;
+                if (offsets[AXIS__X] > 0) {
+                    covered[row] = (chunk_row_t) ((own[row] >> 1) | ((next & 1u) << (CHUNK_SIZE - 1)));
+                } else {
+                    covered[row] = (chunk_row_t) ((own[row] << 1) | (next >> (CHUNK_SIZE - 1)));
+                }
+                continue;
+            }
+
+            ptrdiff_t const ny = (ptrdiff_t) y + offsets[AXIS__Y];
+            ptrdiff_t const nz = (ptrdiff_t) z + offsets[AXIS__Z];
+            if (ny >= 0 && ny < CHUNK_SIZE && nz >= 0 && nz < CHUNK_SIZE) {
+                covered[row] = own[CHUNK_ROW(ny, nz)];
+            } else {
+                covered[row] = neighbour != nullptr ? neighbour[CHUNK_ROW((ny + CHUNK_SIZE) % CHUNK_SIZE, (nz + CHUNK_SIZE) % CHUNK_SIZE)] : edge;
+            }
+        }
+    }
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "src/render/tessellator.h"
 #include "src/render/level_renderer.h"
 #include "src/world/chunk.h"
@@ -14,6 +16,8 @@ chunk_t const* const chunk_renderer_get_chunk(chunk_renderer_t const* const self
 
 bool chunk_renderer_is_ready(chunk_renderer_t const* const self);
 
+uint64_t const chunk_renderer_get_generation(chunk_renderer_t const* const self);
+
 void chunk_renderer_build(chunk_renderer_t* const self, tessellator_t* const tessellator);
 
 void chunk_renderer_draw(chunk_renderer_t const* const self);
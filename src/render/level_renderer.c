@@ -31,6 +31,7 @@
 #define CHUNK_INDEX(x, y, z) (((y) * self->level_slice.size[AXIS__Z] * self->level_slice.size[AXIS__X]) + ((z) * self->level_slice.size[AXIS__X]) + (x))
 #define TO_CHUNK_SPACE(tile_coord) ((tile_coord) / CHUNK_SIZE)
 #define TO_TILE_SPACE(chunk_coord) ((chunk_coord) * CHUNK_SIZE)
+#define MAX_BUILDS_PER_TICK 20
 
 struct level_renderer {
     client_t* client;
@@ -38,10 +39,15 @@ struct level_renderer {
     sprites_t* sprites;
     chunk_renderer_t** chunk_renderers;
     level_slice_t level_slice;
+    // The level generation the journal has been read up to.
+    uint64_t since;
+    // Set while some chunk renderers may need building that the journal will not point at, i.e. new ones or after an overflow.
+    bool needs_sweep;
 };
 
 static void delete_chunk_renderers(level_renderer_t* const self);
 static void reload_chunk_renderers(level_renderer_t* const self);
+static chunk_renderer_t* const get_chunk_renderer(level_renderer_t const* const self, pos_chunks_t const pos[NUM_AXES]);
 
 level_renderer_t* const level_renderer_new(client_t* const client) {
     assert(client != nullptr);
@@ -54,6 +60,7 @@ level_renderer_t* const level_renderer_new(client_t* const client) {
     self->tessellator = tessellator_new();
     self->sprites = sprites_new(client);
     self->chunk_renderers = nullptr;
+    self->needs_sweep = false;
 
     level_renderer_level_changed(self);
 
@@ -89,6 +96,9 @@ void level_renderer_level_changed(level_renderer_t* const self) {
         self->level_slice.pos[a] = 0;
     }
 
+    // Every renderer is rebuilt from scratch, so older edits don't matter.
+    self->since = level_get_generation(level);
+
     reload_chunk_renderers(self);
 }
 
@@ -184,25 +194,54 @@ void level_renderer_tick(level_renderer_t* const self) {
 
     level_t* const level = client_get_level(self->client);
 
-    size_t remaining = 20;
+    size_t remaining = MAX_BUILDS_PER_TICK;
+
+    // Never poll more edits than can be rebuilt, so whatever is left over stays in the journal for the next tick.
+    level_change_t changes[MAX_BUILDS_PER_TICK];
+    while (remaining > 0) {
+        bool overflowed;
+        size_t const num_changes = level_poll_changes(level, &(self->since), changes, remaining, &overflowed);
+        if (overflowed) {
+            self->needs_sweep = true;
+        }
+        if (num_changes == 0) {
+            break;
+        }
+
+        for (size_t i = 0; i < num_changes; i++) {
+            chunk_renderer_t* const chunk_renderer = get_chunk_renderer(self, changes[i].pos);
+            // Renderers that aren't ready yet are picked up by the sweep. Repeated edits to one chunk only rebuild it once.
+            if (chunk_renderer != nullptr && chunk_renderer_is_ready(chunk_renderer) && chunk_renderer_get_generation(chunk_renderer) != level_get_chunk_generation(level, changes[i].pos)) {
+                chunk_renderer_build(chunk_renderer, self->tessellator);
+                remaining--;
+            }
+        }
+    }
+
+    if (!self->needs_sweep) {
+        return;
+    }
+
     size_t const chunks_area = self->level_slice.size[AXIS__Y] * self->level_slice.size[AXIS__Z] * self->level_slice.size[AXIS__X];
     for (size_chunks_t i = 0; i < chunks_area; i++) {
         if (remaining == 0) {
-            break;
+            return;
         }
 
         chunk_renderer_t* const chunk_renderer = self->chunk_renderers[i];
         if (chunk_renderer != nullptr) {
             chunk_t const* const chunk = chunk_renderer_get_chunk(chunk_renderer);
-            size_chunks_t pos[NUM_AXES];
+            pos_chunks_t pos[NUM_AXES];
             chunk_get_pos(chunk, pos);
 
-            if (!chunk_renderer_is_ready(chunk_renderer) || level_is_chunk_dirty(level, pos)) {
+            if (!chunk_renderer_is_ready(chunk_renderer) || chunk_renderer_get_generation(chunk_renderer) != level_get_chunk_generation(level, pos)) {
                 chunk_renderer_build(chunk_renderer, self->tessellator);
                 remaining--;
             }
         }
     }
+
+    self->needs_sweep = false;
 }
 
 void level_renderer_draw(level_renderer_t* const self, camera_t* const camera, float const partial_tick) {
@@ -336,44 +375,10 @@ void level_renderer_draw(level_renderer_t* const self, camera_t* const camera, f
     }
 }
 
-bool const level_renderer_is_tile_side_occluded(level_renderer_t const* const self, size_t const pos[NUM_AXES], side_t const side) {
+level_t* const level_renderer_get_level(level_renderer_t const* const self) {
     assert(self != nullptr);
-    assert(side >= 0 && side < NUM_SIDES);
-
-    level_t* const level = client_get_level(self->client);
-
-    size_chunks_t level_size[NUM_AXES];
-    level_get_size(level, level_size);
 
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        assert(pos[a] >= 0 && pos[a] < TO_TILE_SPACE(level_size[a]));
-    }
-
-    if (
-        (pos[AXIS__X] == 0 && side == SIDE__NORTH) ||
-        (pos[AXIS__X] == TO_TILE_SPACE(level_size[AXIS__X]) - 1 && side == SIDE__SOUTH) ||
-        (pos[AXIS__Y] == 0 && side == SIDE__BOTTOM) ||
-        (pos[AXIS__Z] == 0 && side == SIDE__WEST) ||
-        (pos[AXIS__Z] == TO_TILE_SPACE(level_size[AXIS__Z]) - 1 && side == SIDE__EAST)
-    ) {
-        return true;
-    }
-    if (pos[AXIS__Y] == TO_TILE_SPACE(level_size[AXIS__Y]) - 1 && side == SIDE__TOP) {
-        return false;
-    }
-
-    int offsets[NUM_AXES];
-    side_get_offsets(side, offsets);
-
-    size_t t_pos[NUM_AXES];
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        t_pos[a] = pos[a] + offsets[a];
-    }
-
-    tile_shape_t tshape = level_get_tile_shape(level, t_pos);
-    side_t tside = side_get_opposite(side);
-
-    return tile_shape_can_side_occlude(tshape, tside);
+    return client_get_level(self->client);
 }
 
 static void delete_chunk_renderers(level_renderer_t* const self) {
@@ -422,7 +427,7 @@ static void reload_chunk_renderers(level_renderer_t* const self) {
         for (size_chunks_t y = 0; y < self->level_slice.size[AXIS__Y] && (self->level_slice.pos[AXIS__Y] + y) < level_size[AXIS__Y]; y++) {
             for (size_chunks_t z = 0; z < self->level_slice.size[AXIS__Z] && (self->level_slice.pos[AXIS__Z] + z) < level_size[AXIS__Z]; z++) {
                 if (self->chunk_renderers[CHUNK_INDEX(x, y, z)] == nullptr) {
-                    chunk_t const* const chunk = level_get_chunk(level, (size_chunks_t[NUM_AXES]) { self->level_slice.pos[AXIS__X] + x, self->level_slice.pos[AXIS__Y] + y, self->level_slice.pos[AXIS__Z] + z });
+                    chunk_t const* const chunk = level_get_chunk(level, (pos_chunks_t[NUM_AXES]) { (pos_chunks_t) (self->level_slice.pos[AXIS__X] + x), (pos_chunks_t) (self->level_slice.pos[AXIS__Y] + y), (pos_chunks_t) (self->level_slice.pos[AXIS__Z] + z) });
                     self->chunk_renderers[CHUNK_INDEX(x, y, z)] = chunk_renderer_new(self, chunk);
                     num_reloaded++;
                 }
@@ -432,5 +437,23 @@ static void reload_chunk_renderers(level_renderer_t* const self) {
 
     if (num_reloaded > 0) {
         LOG_DEBUG("level_renderer_t: reloaded %zu chunk renderers.", num_reloaded);
+        self->needs_sweep = true;
     }
+}
+
+static chunk_renderer_t* const get_chunk_renderer(level_renderer_t const* const self, pos_chunks_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+    assert(pos != nullptr);
+
+    if (self->chunk_renderers == nullptr) {
+        return nullptr;
+    }
+
+    for (axis_t a = 0; a < NUM_AXES; a++) {
+        if (pos[a] < 0 || (size_chunks_t) pos[a] < self->level_slice.pos[a] || (size_chunks_t) pos[a] >= self->level_slice.pos[a] + self->level_slice.size[a]) {
+            return nullptr;
+        }
+    }
+
+    return self->chunk_renderers[CHUNK_INDEX((size_chunks_t) pos[AXIS__X] - self->level_slice.pos[AXIS__X], (size_chunks_t) pos[AXIS__Y] - self->level_slice.pos[AXIS__Y], (size_chunks_t) pos[AXIS__Z] - self->level_slice.pos[AXIS__Z])];
 }
\ No newline at end of file
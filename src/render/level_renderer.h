@@ -25,4 +25,4 @@ void level_renderer_tick(level_renderer_t* const self);
 
 void level_renderer_draw(level_renderer_t* const self, camera_t* const camera, float const partial_tick);
 
-bool const level_renderer_is_tile_side_occluded(level_renderer_t const* const self, size_t const pos[NUM_AXES], side_t const side);
+level_t* const level_renderer_get_level(level_renderer_t const* const self);
@@ -162,7 +162,7 @@ static void draw_overlay(renderer_t* const self) {
         raycast_t raycast;
         raycast_cast_in_level(&raycast, level, following_pos->pos, following_rot->rot);
         if (raycast.hit) {
-            snprintf(line_buffer, sizeof(line_buffer), "hit: %zu %zu %zu, block: %d", raycast.tile_pos[AXIS__X], raycast.tile_pos[AXIS__Y], raycast.tile_pos[AXIS__Z], raycast.tile);
+            snprintf(line_buffer, sizeof(line_buffer), "hit: %td %td %td, block: %d", raycast.tile_pos[AXIS__X], raycast.tile_pos[AXIS__Y], raycast.tile_pos[AXIS__Z], raycast.tile);
             font_draw(font, line_buffer, 0, i++ * 12);
         }
 
@@ -458,11 +458,11 @@ static void entity_tick(_view_type_entity_t* const self, level_t* const level) {
 
             if (raycast.hit) {
                 if (self->keys.left_click) {
-                    level_set_tile(level, raycast.tile_pos, TILE__AIR);
+                    level_set_tile_smoothed(level, raycast.tile_pos, TILE__AIR);
                 } else if (self->keys.right_click) {
                     int offset[NUM_AXES];
                     side_get_offsets(raycast.side, offset);
-                    level_set_tile(level, VEC_ADD(raycast.tile_pos, offset), TILE__STONE);
+                    level_set_tile_smoothed(level, VEC_ADD(raycast.tile_pos, offset), TILE__STONE);
                 }
             }
         }
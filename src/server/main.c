@@ -1,5 +1,13 @@
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+
 #include "src/server/server.h"
 #include "src/util/logger.h"
+#include "src/util/util.h"
+#include "src/world/chunk.h"
 #include "src/world/tile.h"
 
 int main(int argc, char** argv) {
@@ -7,14 +15,33 @@ int main(int argc, char** argv) {
 
     LOG_INFO("Starting RudyScung server...");
 
+    // A fixed seed lets a fresh world reuse the terrain cached by an earlier run.
+    uint64_t seed = (uint64_t) get_time_ms();
+    if (argc > 1) {
+        char* end;
+        errno = 0;
+        seed = strtoull(argv[1], &end, 10);
+        // strtoull would also take leading whitespace, a sign or trailing junk, and clamp on overflow.
+        if (!isdigit((unsigned char) argv[1][0]) || *end != '\0' || errno != 0) {
+            LOG_ERROR("Invalid seed '%s', expected a number from 0 to %" PRIu64 ".", argv[1], UINT64_MAX);
+            return EXIT_FAILURE;
+        }
+
+        LOG_DEBUG("Seed set to %" PRIu64 ".", seed);
+    }
+
     // static initialization
     tiles_init();
 
     // init rudyscung server
-    server_t* const server = server_new();
+    server_t* const server = server_new(seed);
     server_run(server);
 
     server_delete(server);
-    
+
+    // static cleanup
+    tiles_cleanup();
+    chunks_cleanup();
+
     return 0;
 }
\ No newline at end of file
@@ -13,17 +13,24 @@
 
 #define TICKS_PER_SECOND 20
 #define MS_PER_TICK (1000 / (TICKS_PER_SECOND))
+#define SAVE_INTERVAL_TICKS (TICKS_PER_SECOND * 60)
+#define WORLD_PATH "world"
+#define GEN_CACHE_PATH "gen_cache"
 
 struct server {
-
+    uint64_t seed;
+    size_t ticks_since_save;
 };
 
 static void tick(server_t* const self, level_t* const level);
 
-server_t* const server_new() {
+server_t* const server_new(uint64_t const seed) {
     server_t* self = malloc(sizeof(server_t));
     assert(self != nullptr);
 
+    self->seed = seed;
+    self->ticks_since_save = 0;
+
     OBJ_CTR_INC(server_t);
 
     return self;
@@ -42,7 +49,16 @@ void server_run(server_t* const self) {
 
 #define LEVEL_SIZE 16
 #define LEVEL_HEIGHT 8
-    level_t* const level = level_new((size_chunks_t[NUM_AXES]) { LEVEL_SIZE, LEVEL_SIZE, LEVEL_HEIGHT });
+    level_t* level = level_load(WORLD_PATH);
+    if (level == nullptr) {
+        level = level_new(&(level_settings_t) {
+            .size = { LEVEL_SIZE, LEVEL_SIZE, LEVEL_HEIGHT },
+            .seed = self->seed,
+            .lazy = false,
+            .cache_path = GEN_CACHE_PATH
+        });
+        level_save(level, WORLD_PATH);
+    }
 
     bool running = true;
     uint64_t last_game_tick = get_time_ms();
@@ -58,6 +74,7 @@ void server_run(server_t* const self) {
         last_game_tick = current_tick - (delta_tick % MS_PER_TICK);
     }
 
+    level_save(level, WORLD_PATH);
     level_delete(level);
 }
 
@@ -66,4 +83,10 @@ static void tick(server_t* const self, level_t* const level) {
     assert(level != nullptr);
 
     level_tick(level);
+
+    self->ticks_since_save++;
+    if (self->ticks_since_save >= SAVE_INTERVAL_TICKS) {
+        level_save(level, WORLD_PATH);
+        self->ticks_since_save = 0;
+    }
 }
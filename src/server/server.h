@@ -1,8 +1,11 @@
 #pragma once
 
+#include <stdint.h>
+
 typedef struct server server_t;
 
-server_t* const server_new();
+// The seed is only used if there is no saved world to load.
+server_t* const server_new(uint64_t const seed);
 
 void server_delete(server_t* const self);
 
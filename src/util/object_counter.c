@@ -1,5 +1,6 @@
 #include "./object_counter.h"
 
+#include <pthread.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -17,61 +18,67 @@ typedef struct entry {
 
 #if ENABLE_OBJECT_COUNTER
 static entry_t ENTRIES[MAX_ENTRIES];
+// Objects are also created and deleted by background threads, such as the level saver.
+static pthread_mutex_t ENTRIES_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+static entry_t* const get_entry(char const* const name);
 #endif
 
 void object_counter_increment(char const* const name) {
 #if ENABLE_OBJECT_COUNTER
-    for (size_t i = 0; i < MAX_ENTRIES; i++) {
-        entry_t* entry = &(ENTRIES[i]);
-
-        if (entry->name == nullptr) {
-            entry->name = name;
-            entry->num_created = 1;
-            return;
-        }
-        if (entry->name == name) {
-            entry->num_created++;
-            return;
-        }
+    pthread_mutex_lock(&ENTRIES_LOCK);
+    entry_t* const entry = get_entry(name);
+    if (entry != nullptr) {
+        entry->num_created++;
     }
-
-    LOG_ERROR("object_counter_t: MAX_ENTRIES reached.");
+    pthread_mutex_unlock(&ENTRIES_LOCK);
 #endif
 }
 
 void object_counter_decrement(char const* const name) {
+#if ENABLE_OBJECT_COUNTER
+    pthread_mutex_lock(&ENTRIES_LOCK);
+    entry_t* const entry = get_entry(name);
+    if (entry != nullptr) {
+        entry->num_deleted++;
+    }
+    pthread_mutex_unlock(&ENTRIES_LOCK);
+#endif
+}
+
+void object_counter_summarize(bool const is_final) {
 #if ENABLE_OBJECT_COUNTER
     for (size_t i = 0; i < MAX_ENTRIES; i++) {
         entry_t* entry = &(ENTRIES[i]);
 
         if (entry->name == nullptr) {
-            entry->name = name;
-            entry->num_deleted = 1;
             return;
         }
-        if (entry->name == name) {
-            entry->num_deleted++;
-            return;
+
+        LOG_INFO("object_counter_t: %s: %zu created, %zu deleted, %zu current.", entry->name, entry->num_created, entry->num_deleted, entry->num_created - entry->num_deleted);
+        if (is_final && entry->num_created != entry->num_deleted) {
+            LOG_WARN("object_counter_t: %s: %zu not deleted!", entry->name, entry->num_created - entry->num_deleted);
         }
     }
-
-    LOG_ERROR("object_counter_t: MAX_ENTRIES reached.");
 #endif
 }
 
-void object_counter_summarize(bool const is_final) {
 #if ENABLE_OBJECT_COUNTER
+static entry_t* const get_entry(char const* const name) {
     for (size_t i = 0; i < MAX_ENTRIES; i++) {
         entry_t* entry = &(ENTRIES[i]);
 
         if (entry->name == nullptr) {
-            return;
+            entry->name = name;
+            return entry;
         }
-
-        LOG_INFO("object_counter_t: %s: %zu created, %zu deleted, %zu current.", entry->name, entry->num_created, entry->num_deleted, entry->num_created - entry->num_deleted);
-        if (is_final && entry->num_created != entry->num_deleted) {
-            LOG_WARN("object_counter_t: %s: %zu not deleted!", entry->name, entry->num_created - entry->num_deleted);
+        if (entry->name == name) {
+            return entry;
         }
     }
+
+    LOG_ERROR("object_counter_t: MAX_ENTRIES reached.");
+
+    return nullptr;
+}
 #endif
-}
\ No newline at end of file
@@ -0,0 +1,189 @@
+// Needed for sysconf(_SC_NPROCESSORS_ONLN) under strict C.
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include "./thread_pool.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "src/util/logger.h"
+#include "src/util/object_counter.h"
+
+/* SCHEDULING:
+ *     Each call to thread_pool_run starts a new batch. Every worker wakes
+ *     once per batch and, like the calling thread, claims task indices
+ *     from a shared atomic counter until they run out, so uneven tasks
+ *     still balance. A batch is over once every worker has checked back
+ *     in, which also makes the tasks' writes visible to the caller.
+ */
+
+struct thread_pool {
+    pthread_mutex_t lock;
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    // Excludes the calling thread.
+    pthread_t* workers;
+    size_t num_workers;
+    uint64_t batch;
+    thread_pool_task_t task;
+    void* arg;
+    size_t num_tasks;
+    atomic_size_t next_task;
+    size_t num_busy;
+    bool is_stopping;
+};
+
+static void* run_worker(void* const arg);
+static void run_tasks(thread_pool_t* const self);
+static size_t const get_num_cpus(void);
+
+thread_pool_t* const thread_pool_new(size_t const num_threads) {
+    size_t const total_threads = num_threads > 0 ? num_threads : get_num_cpus();
+
+    thread_pool_t* const self = malloc(sizeof(thread_pool_t));
+    assert(self != nullptr);
+
+    pthread_mutex_init(&(self->lock), nullptr);
+    pthread_cond_init(&(self->start_cond), nullptr);
+    pthread_cond_init(&(self->done_cond), nullptr);
+    self->num_workers = total_threads - 1;
+    self->workers = self->num_workers > 0 ? malloc(sizeof(pthread_t) * self->num_workers) : nullptr;
+    assert(self->num_workers == 0 || self->workers != nullptr);
+    self->batch = 0;
+    self->task = nullptr;
+    self->arg = nullptr;
+    self->num_tasks = 0;
+    atomic_init(&(self->next_task), 0);
+    self->num_busy = 0;
+    self->is_stopping = false;
+
+    for (size_t i = 0; i < self->num_workers; i++) {
+        int const result = pthread_create(&(self->workers[i]), nullptr, run_worker, self);
+        assert(result == 0);
+    }
+
+    LOG_DEBUG("thread_pool_t: started %zu threads.", total_threads);
+
+    OBJ_CTR_INC(thread_pool_t);
+
+    return self;
+}
+
+void thread_pool_delete(thread_pool_t* const self) {
+    assert(self != nullptr);
+
+    pthread_mutex_lock(&(self->lock));
+    self->is_stopping = true;
+    pthread_cond_broadcast(&(self->start_cond));
+    pthread_mutex_unlock(&(self->lock));
+
+    for (size_t i = 0; i < self->num_workers; i++) {
+        pthread_join(self->workers[i], nullptr);
+    }
+    free(self->workers);
+
+    pthread_cond_destroy(&(self->done_cond));
+    pthread_cond_destroy(&(self->start_cond));
+    pthread_mutex_destroy(&(self->lock));
+
+    free(self);
+
+    OBJ_CTR_DEC(thread_pool_t);
+}
+
+size_t const thread_pool_get_num_threads(thread_pool_t const* const self) {
+    assert(self != nullptr);
+
+    return self->num_workers + 1;
+}
+
+void thread_pool_run(thread_pool_t* const self, size_t const num_tasks, thread_pool_task_t const task, void* const arg) {
+    assert(self != nullptr);
+    assert(task != nullptr);
+
+    if (num_tasks == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&(self->lock));
+    self->task = task;
+    self->arg = arg;
+    self->num_tasks = num_tasks;
+    atomic_store_explicit(&(self->next_task), 0, memory_order_relaxed);
+    self->num_busy = self->num_workers;
+    self->batch++;
+    pthread_cond_broadcast(&(self->start_cond));
+    pthread_mutex_unlock(&(self->lock));
+
+    run_tasks(self);
+
+    pthread_mutex_lock(&(self->lock));
+    while (self->num_busy > 0) {
+        pthread_cond_wait(&(self->done_cond), &(self->lock));
+    }
+    pthread_mutex_unlock(&(self->lock));
+}
+
+static void* run_worker(void* const arg) {
+    thread_pool_t* const self = arg;
+    uint64_t last_batch = 0;
+
+    pthread_mutex_lock(&(self->lock));
+    while (true) {
+        while (self->batch == last_batch && !self->is_stopping) {
+            pthread_cond_wait(&(self->start_cond), &(self->lock));
+        }
+        if (self->is_stopping) {
+            break;
+        }
+        last_batch = self->batch;
+        pthread_mutex_unlock(&(self->lock));
+
+        run_tasks(self);
+
+        pthread_mutex_lock(&(self->lock));
+        self->num_busy--;
+        if (self->num_busy == 0) {
+            pthread_cond_signal(&(self->done_cond));
+        }
+    }
+    pthread_mutex_unlock(&(self->lock));
+
+    return nullptr;
+}
+
+static void run_tasks(thread_pool_t* const self) {
+    // The batch cannot change until this thread checks back in, so these are stable.
+    thread_pool_task_t const task = self->task;
+    void* const arg = self->arg;
+    size_t const num_tasks = self->num_tasks;
+
+    size_t index;
+    while ((index = atomic_fetch_add_explicit(&(self->next_task), 1, memory_order_relaxed)) < num_tasks) {
+        task(arg, index);
+    }
+}
+
+static size_t const get_num_cpus(void) {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return info.dwNumberOfProcessors > 0 ? (size_t) info.dwNumberOfProcessors : 1;
+#else
+    long const num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return num_cpus > 0 ? (size_t) num_cpus : 1;
+#endif
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+
+typedef struct thread_pool thread_pool_t;
+
+typedef void (*thread_pool_task_t)(void* const arg, size_t const index);
+
+// num_threads counts the calling thread, which works alongside the pool during thread_pool_run. 0 uses one thread per CPU core.
+thread_pool_t* const thread_pool_new(size_t const num_threads);
+
+void thread_pool_delete(thread_pool_t* const self);
+
+size_t const thread_pool_get_num_threads(thread_pool_t const* const self);
+
+// Calls task once for each index below num_tasks, spread over the pool, and returns once all calls have finished.
+// Indices are handed out in increasing order, so a task may wait for one with a lower index to make progress.
+void thread_pool_run(thread_pool_t* const self, size_t const num_tasks, thread_pool_task_t const task, void* const arg);
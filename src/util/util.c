@@ -1,3 +1,8 @@
+// Needed for clock_gettime(CLOCK_MONOTONIC) under strict C.
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
 #include "./util.h"
 
 #include <assert.h>
@@ -5,6 +10,7 @@
 #include <string.h>
 #include <math.h>
 #include <sys/time.h>
+#include <time.h>
 
 char* const strcata(char const* const a, char const* const b) {
     char* const result = malloc(strlen(a) + strlen(b) + 1);
@@ -37,4 +43,11 @@ unsigned long const get_time_ms(void) {
     gettimeofday(&time, nullptr);
 
     return time.tv_sec * 1000 + time.tv_usec / 1000;
+}
+
+uint64_t const get_time_ns(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return ((uint64_t) time.tv_sec * 1000000000) + (uint64_t) time.tv_nsec;
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #ifndef M_PI
 #define M_PI   3.14159265358979323846264338327950288
 #endif
@@ -26,4 +28,7 @@ float const absf(float const x);
 
 float const map_to_0_1(float const x);
 
-unsigned long const get_time_ms(void);
\ No newline at end of file
+unsigned long const get_time_ms(void);
+
+// Monotonic time with nanosecond resolution, for timing short stretches of code. Only differences between calls mean anything.
+uint64_t const get_time_ns(void);
\ No newline at end of file
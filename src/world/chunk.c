@@ -1,35 +1,162 @@
 #include "./chunk.h"
 
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "src/util/logger.h"
 #include "src/util/object_counter.h"
+#include "src/world/chunk_arena.h"
+#include "src/world/chunk_codec.h"
 
 #define COORD(pos) (((pos[AXIS__Y]) * CHUNK_SIZE * CHUNK_SIZE) + ((pos[AXIS__Z]) * CHUNK_SIZE) + (pos[AXIS__X]))
+#define CHUNK_VOLUME (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+#define MAX_PALETTE_SIZE (NUM_TILES * NUM_TILE_SHAPES)
+#define INDICES_SIZE(bits) ((CHUNK_VOLUME * (bits)) / 8)
+// Index buffers are preceded by a reference count and their bits per voxel, padded so the indices keep the arena's slot alignment.
+#define INDICES_HEADER_SIZE 64
+#define INDICES_REFS(indices) (*((uint32_t*) ((indices) - INDICES_HEADER_SIZE)))
+// Kept clear of the free list link the arena writes over the start of a released slot, so it stays readable through a stale pointer.
+#define INDICES_BITS(indices) (((indices) - INDICES_HEADER_SIZE)[sizeof(void*)])
+#define NUM_ROWS (CHUNK_SIZE * CHUNK_SIZE)
+// How often a reader pauses on a chunk being written before yielding instead.
+#define MAX_READ_SPINS 64
+
+static_assert(CHUNK_SIZE <= sizeof(chunk_row_t) * 8, "a chunk row must fit in chunk_row_t");
+static_assert(sizeof(void*) < INDICES_HEADER_SIZE, "the bits per voxel must fit in the header after the free list link");
+
+/* STORAGE FORMAT:
+ *     Each voxel stores an index into a small palette of (tile, tile shape)
+ *     pairs. Indices are bit-packed at 1, 2, 4 or 8 bits per voxel, growing
+ *     as the palette fills up. Palette entries are reference counted so that
+ *     slots freed by overwritten voxels can be reused.
+ *
+ *     A chunk holding a single (tile, tile shape) pair is uniform: it uses 0
+ *     bits per voxel and points at the shared, immutable UNIFORM_INDICES
+ *     sentinel instead of owning any index storage. Real storage is only
+ *     allocated on the first write that breaks uniformity, and is released
+ *     again once every voxel holds the same pair.
+ *
+ *     Snapshots share their source's index buffer, which is reference
+ *     counted and copied by whichever chunk next writes to it. Reference
+ *     counts are not atomic, so snapshots must be taken and deleted on the
+ *     thread that owns the source; other threads may only read them.
+ *
+ *     Alongside the indices, each chunk keeps bit masks of its non-air
+ *     tiles and of the tiles fully covering each side. Every voxel write
+ *     goes through set_entry, which keeps them in step.
+ */
+
+/* CONCURRENT READS:
+ *     Only the owning thread writes to a chunk, but other threads may read
+ *     it through a sequence lock. Each public write bumps the sequence to
+ *     odd before touching anything and back to even afterwards. A reader
+ *     copies what it needs, then checks the sequence is still the even
+ *     value it started from, and retries otherwise; writers never wait.
+ *
+ *     A racing reader can see a half-written palette or an index buffer
+ *     that has just been released. Arena slabs are never unmapped, so such
+ *     reads return garbage rather than faulting, and the sequence check
+ *     throws the garbage away. Nothing read inside a read section may be
+ *     used to index memory until it has been validated. The one exception
+ *     is the bits per voxel in an index buffer's header: a slot only ever
+ *     holds buffers of its arena's width, so the header sizes the copy
+ *     correctly even when the chunk's bits and indices are out of step.
+ */
 
 struct chunk {
-    size_chunks_t pos[NUM_AXES];
-    uint8_t tiles[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
-    uint8_t tile_shapes[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+    pos_chunks_t pos[NUM_AXES];
+    uint8_t bits;
+    uint8_t palette_size;
+    uint8_t palette_tiles[MAX_PALETTE_SIZE];
+    uint8_t palette_shapes[MAX_PALETTE_SIZE];
+    uint16_t palette_refs[MAX_PALETTE_SIZE];
+    uint16_t tile_counts[NUM_TILES];
+    uint8_t* indices;
+    chunk_row_t occupancy[NUM_ROWS];
+    chunk_row_t full_faces[NUM_SIDES][NUM_ROWS];
+    atomic_uint sequence;
 };
 
-chunk_t* const chunk_new(size_chunks_t const pos[NUM_AXES]) {
-    chunk_t* const self = malloc(sizeof(chunk_t));
-    assert(self != nullptr);
+// Laid out like an allocated index buffer, so its header reads as 0 bits per voxel.
+static uint8_t const UNIFORM_BUFFER[INDICES_HEADER_SIZE + 1] = { 0 };
+#define UNIFORM_INDICES (&(UNIFORM_BUFFER[INDICES_HEADER_SIZE]))
 
-    memcpy(self->pos, pos, sizeof(size_chunks_t) * NUM_AXES);
-    for (size_t x = 0; x < CHUNK_SIZE; x++) {
-        for (size_t y = 0; y < CHUNK_SIZE; y++) {
-            for (size_t z = 0; z < CHUNK_SIZE; z++) {
-                size_t const i_pos[NUM_AXES] = { x, y, z };
-                self->tiles[COORD(i_pos)] = TILE__AIR;
-                self->tile_shapes[COORD(i_pos)] = TILE_SHAPE__NO_RENDER;
-            }
-        }
+// Chunks and their index buffers come from process-wide arenas, one per allocation size, created together on first use.
+static pthread_once_t arenas_once = PTHREAD_ONCE_INIT;
+static chunk_arena_t* chunk_arena = nullptr;
+// Indexed by bits per voxel; only 1, 2, 4 and 8 are used.
+static chunk_arena_t* indices_arenas[8 + 1] = { nullptr };
+
+static void create_arenas(void);
+
+static size_t const get_index(chunk_t const* const self, size_t const i);
+
+static void set_index(chunk_t* const self, size_t const i, size_t const index);
+
+static size_t const find_or_add_palette_entry(chunk_t* const self, tile_t const tile, tile_shape_t const shape);
+
+static uint8_t* const alloc_indices(uint8_t const bits);
+
+static void release_indices(uint8_t const bits, uint8_t* const indices);
+
+static void unshare_indices(chunk_t* const self);
+
+static void grow_indices(chunk_t* const self);
+
+static void make_uniform(chunk_t* const self, size_t const index);
+
+static void set_entry(chunk_t* const self, size_t const i, tile_t const tile, tile_shape_t const shape);
+
+static void begin_write(chunk_t* const self);
+
+static void end_write(chunk_t* const self);
+
+static uint32_t const read_u32(uint8_t const* const data);
+
+static uint64_t const read_u64(uint8_t const* const data);
+
+static void write_u32(uint8_t* const data, uint32_t const value);
+
+static void write_u64(uint8_t* const data, uint64_t const value);
+
+void chunks_cleanup(void) {
+    // The arenas only exist once a chunk has been created.
+    if (chunk_arena == nullptr) {
+        return;
     }
 
+    chunk_arena_delete(chunk_arena);
+    chunk_arena = nullptr;
+    for (uint8_t bits = 1; bits <= 8; bits *= 2) {
+        chunk_arena_delete(indices_arenas[bits]);
+        indices_arenas[bits] = nullptr;
+    }
+}
+
+chunk_t* const chunk_new(pos_chunks_t const pos[NUM_AXES]) {
+    pthread_once(&arenas_once, create_arenas);
+
+    chunk_t* const self = chunk_arena_alloc(chunk_arena);
+    assert(self != nullptr);
+
+    memcpy(self->pos, pos, sizeof(pos_chunks_t) * NUM_AXES);
+
+    self->bits = 0;
+    self->palette_size = 1;
+    self->palette_tiles[0] = TILE__AIR;
+    self->palette_shapes[0] = TILE_SHAPE__NO_RENDER;
+    self->palette_refs[0] = CHUNK_VOLUME;
+    memset(self->tile_counts, 0, sizeof(self->tile_counts));
+    self->tile_counts[TILE__AIR] = CHUNK_VOLUME;
+    self->indices = (uint8_t*) UNIFORM_INDICES;
+    memset(self->occupancy, 0, sizeof(self->occupancy));
+    memset(self->full_faces, 0, sizeof(self->full_faces));
+    atomic_init(&(self->sequence), 0);
+
     OBJ_CTR_INC(chunk_t);
 
     return self;
@@ -38,15 +165,35 @@ chunk_t* const chunk_new(size_chunks_t const pos[NUM_AXES]) {
 void chunk_delete(chunk_t* const chunk) {
     assert(chunk != nullptr);
 
-    free(chunk);
+    if (chunk->indices != UNIFORM_INDICES) {
+        release_indices(chunk->bits, chunk->indices);
+    }
+    chunk_arena_free(chunk_arena, chunk);
 
     OBJ_CTR_DEC(chunk_t);
 }
 
-void chunk_get_pos(chunk_t const* const self, size_chunks_t pos[NUM_AXES]) {
+chunk_t* const chunk_snapshot(chunk_t const* const self) {
+    assert(self != nullptr);
+
+    chunk_t* const snapshot = chunk_arena_alloc(chunk_arena);
+    assert(snapshot != nullptr);
+
+    memcpy(snapshot, self, sizeof(chunk_t));
+    if (snapshot->indices != UNIFORM_INDICES) {
+        INDICES_REFS(snapshot->indices)++;
+    }
+    atomic_init(&(snapshot->sequence), 0);
+
+    OBJ_CTR_INC(chunk_t);
+
+    return snapshot;
+}
+
+void chunk_get_pos(chunk_t const* const self, pos_chunks_t pos[NUM_AXES]) {
     assert(self != nullptr);
 
-    memcpy(pos, self->pos, sizeof(size_chunks_t) * NUM_AXES);
+    memcpy(pos, self->pos, sizeof(pos_chunks_t) * NUM_AXES);
 }
 
 tile_t const chunk_get_tile(chunk_t const* const self, size_t const pos[NUM_AXES]) {
@@ -55,7 +202,7 @@ tile_t const chunk_get_tile(chunk_t const* const self, size_t const pos[NUM_AXES
         assert(pos[a] >= 0 && pos[a] < CHUNK_SIZE);
     }
 
-    return self->tiles[COORD(pos)];
+    return self->palette_tiles[get_index(self, COORD(pos))];
 }
 
 void chunk_set_tile(chunk_t* const self, size_t const pos[NUM_AXES], tile_t const tile) {
@@ -65,12 +212,9 @@ void chunk_set_tile(chunk_t* const self, size_t const pos[NUM_AXES], tile_t cons
     }
     assert(tile >= 0 && tile < NUM_TILES);
 
-    self->tiles[COORD(pos)] = tile;
-    if (tile == TILE__AIR) {
-        chunk_set_tile_shape(self, pos, TILE_SHAPE__NO_RENDER);
-    } else {
-        chunk_set_tile_shape(self, pos, TILE_SHAPE__FLAT);
-    }
+    begin_write(self);
+    set_entry(self, COORD(pos), tile, tile == TILE__AIR ? TILE_SHAPE__NO_RENDER : TILE_SHAPE__FLAT);
+    end_write(self);
 }
 
 tile_shape_t const chunk_get_tile_shape(chunk_t const* const self, size_t const pos[NUM_AXES]) {
@@ -79,7 +223,7 @@ tile_shape_t const chunk_get_tile_shape(chunk_t const* const self, size_t const
         assert(pos[a] >= 0 && pos[a] < CHUNK_SIZE);
     }
 
-    return self->tile_shapes[COORD(pos)];
+    return self->palette_shapes[get_index(self, COORD(pos))];
 }
 
 void chunk_set_tile_shape(chunk_t* const self, size_t const pos[NUM_AXES], tile_shape_t const shape) {
@@ -89,138 +233,501 @@ void chunk_set_tile_shape(chunk_t* const self, size_t const pos[NUM_AXES], tile_
     }
     assert(shape >= 0 && shape < NUM_TILE_SHAPES);
 
-    self->tile_shapes[COORD(pos)] = shape;
+    size_t const i = COORD(pos);
+
+    begin_write(self);
+    set_entry(self, i, self->palette_tiles[get_index(self, i)], shape);
+    end_write(self);
+}
+
+void chunk_read_region(chunk_t const* const self, size_t const min[NUM_AXES], size_t const max[NUM_AXES], size_t const strides[NUM_AXES], tile_t* const tiles, tile_shape_t* const shapes) {
+    assert(self != nullptr);
+    for (axis_t a = 0; a < NUM_AXES; a++) {
+        assert(min[a] <= max[a] && max[a] <= CHUNK_SIZE);
+    }
+
+    for (size_t y = min[AXIS__Y]; y < max[AXIS__Y]; y++) {
+        for (size_t z = min[AXIS__Z]; z < max[AXIS__Z]; z++) {
+            size_t const row = COORD(((size_t[NUM_AXES]) { 0, y, z }));
+            size_t out = ((y - min[AXIS__Y]) * strides[AXIS__Y]) + ((z - min[AXIS__Z]) * strides[AXIS__Z]);
+            for (size_t x = min[AXIS__X]; x < max[AXIS__X]; x++, out += strides[AXIS__X]) {
+                size_t const index = self->bits == 0 ? 0 : get_index(self, row + x);
+                if (tiles != nullptr) {
+                    tiles[out] = self->palette_tiles[index];
+                }
+                if (shapes != nullptr) {
+                    shapes[out] = self->palette_shapes[index];
+                }
+            }
+        }
+    }
+}
+
+void chunk_write_region(chunk_t* const self, size_t const min[NUM_AXES], size_t const max[NUM_AXES], size_t const strides[NUM_AXES], tile_t const* const tiles, tile_shape_t const* const shapes) {
+    assert(self != nullptr);
+    assert(tiles != nullptr || shapes != nullptr);
+    for (axis_t a = 0; a < NUM_AXES; a++) {
+        assert(min[a] <= max[a] && max[a] <= CHUNK_SIZE);
+    }
+
+    begin_write(self);
+    for (size_t y = min[AXIS__Y]; y < max[AXIS__Y]; y++) {
+        for (size_t z = min[AXIS__Z]; z < max[AXIS__Z]; z++) {
+            size_t const row = COORD(((size_t[NUM_AXES]) { 0, y, z }));
+            size_t in = ((y - min[AXIS__Y]) * strides[AXIS__Y]) + ((z - min[AXIS__Z]) * strides[AXIS__Z]);
+            for (size_t x = min[AXIS__X]; x < max[AXIS__X]; x++, in += strides[AXIS__X]) {
+                // Without shapes, tiles get the same default shape as chunk_set_tile; without tiles, shapes keep the existing tile.
+                tile_t const tile = tiles != nullptr ? tiles[in] : self->palette_tiles[get_index(self, row + x)];
+                tile_shape_t const shape = shapes != nullptr ? shapes[in] : (tile == TILE__AIR ? TILE_SHAPE__NO_RENDER : TILE_SHAPE__FLAT);
+                assert(tile >= 0 && tile < NUM_TILES);
+                assert(shape >= 0 && shape < NUM_TILE_SHAPES);
+                set_entry(self, row + x, tile, shape);
+            }
+        }
+    }
+    end_write(self);
+}
+
+size_t const chunk_get_tile_count(chunk_t const* const self, tile_t const tile) {
+    assert(self != nullptr);
+    assert(tile >= 0 && tile < NUM_TILES);
+
+    return self->tile_counts[tile];
+}
+
+bool const chunk_is_uniform(chunk_t const* const self) {
+    assert(self != nullptr);
+
+    return self->bits == 0;
+}
+
+bool const chunk_is_empty(chunk_t const* const self) {
+    assert(self != nullptr);
+
+    return self->tile_counts[TILE__AIR] == CHUNK_VOLUME;
+}
+
+unsigned const chunk_read_begin(chunk_t const* const self) {
+    assert(self != nullptr);
+
+    for (size_t spins = 0; true; spins++) {
+        unsigned const sequence = atomic_load_explicit(&(self->sequence), memory_order_acquire);
+        if ((sequence & 1) == 0) {
+            return sequence;
+        }
+        // Writes are short, so spin politely for a while before handing the core back.
+        if (spins < MAX_READ_SPINS) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+bool const chunk_read_validate(chunk_t const* const self, unsigned const sequence) {
+    assert(self != nullptr);
+
+    // Keeps the reads before this from moving past the check.
+    atomic_thread_fence(memory_order_acquire);
+
+    return atomic_load_explicit(&(self->sequence), memory_order_relaxed) == sequence;
+}
+
+void chunk_read_snapshot(chunk_t const* const self, tile_t* const tiles, tile_shape_t* const shapes, chunk_row_t* const occupancy) {
+    assert(self != nullptr);
+
+    uint8_t bits;
+    uint8_t palette_tiles[MAX_PALETTE_SIZE];
+    uint8_t palette_shapes[MAX_PALETTE_SIZE];
+    uint8_t indices[INDICES_SIZE(8)];
+
+    // Copy the raw state without interpreting it, then decode only once the copy is known to be consistent.
+    while (true) {
+        unsigned const sequence = chunk_read_begin(self);
+
+        // Sized by the buffer itself rather than self->bits, which may not match the pointer mid-write.
+        uint8_t const* const source = self->indices;
+        bits = INDICES_BITS(source);
+        memcpy(palette_tiles, self->palette_tiles, sizeof(palette_tiles));
+        memcpy(palette_shapes, self->palette_shapes, sizeof(palette_shapes));
+        if (bits == 1 || bits == 2 || bits == 4 || bits == 8) {
+            memcpy(indices, source, INDICES_SIZE(bits));
+        }
+        if (occupancy != nullptr) {
+            memcpy(occupancy, self->occupancy, sizeof(self->occupancy));
+        }
+
+        if (chunk_read_validate(self, sequence)) {
+            break;
+        }
+    }
+
+    chunk_t copy = { .bits = bits, .indices = indices };
+    for (size_t i = 0; i < CHUNK_VOLUME; i++) {
+        size_t const index = bits == 0 ? 0 : get_index(&copy, i);
+        if (tiles != nullptr) {
+            tiles[i] = palette_tiles[index];
+        }
+        if (shapes != nullptr) {
+            shapes[i] = palette_shapes[index];
+        }
+    }
+}
+
+chunk_row_t const* const chunk_get_occupancy(chunk_t const* const self) {
+    assert(self != nullptr);
+
+    return self->occupancy;
+}
+
+chunk_row_t const* const chunk_get_full_faces(chunk_t const* const self, side_t const side) {
+    assert(self != nullptr);
+    assert(side >= 0 && side < NUM_SIDES);
+
+    return self->full_faces[side];
 }
 
 /* SERIALIZATION FORMAT:
  *     1 byte marker
  *     4 bytes data size (not including preamble)
  *     n bytes data
+ *
+ *     Version 1 stores the tiles and tile shapes raw. Version 2 stores both
+ *     in a single PACKED marker, compressed with chunk_codec. Both versions
+ *     can be read.
  */
 
-#define FORMAT_VERSION 1
+#define FORMAT_VERSION 2
 
 typedef enum ser_marker {
     SER_MARKER__VERSION,
     SER_MARKER__POS,
     SER_MARKER__TILES,
     SER_MARKER__TILE_SHAPES,
+    SER_MARKER__PACKED,
     NUM_SER_MARKERS
 } ser_marker_t;
 
+// Minimum data size of each marker.
 static size_t const EXPECTED_DATA_SIZES[NUM_SER_MARKERS] = {
     [SER_MARKER__VERSION] = 4,
     [SER_MARKER__POS] = 8 + 8 + 8,
     [SER_MARKER__TILES] = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE,
-    [SER_MARKER__TILE_SHAPES] = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE
+    [SER_MARKER__TILE_SHAPES] = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE,
+    [SER_MARKER__PACKED] = 0
 };
 
 size_t const chunk_serialize(chunk_t const* const self, uint8_t* const data) {
     assert(self != nullptr);
 
-    size_t expected_size = 0;
-    for (ser_marker_t marker = 0; marker < NUM_SER_MARKERS; marker++) {
-        expected_size += 1;
-        expected_size += 4;
-        expected_size += EXPECTED_DATA_SIZES[marker];
-    }
+    size_t const header_size =
+        1 + 4 + EXPECTED_DATA_SIZES[SER_MARKER__VERSION] +
+        1 + 4 + EXPECTED_DATA_SIZES[SER_MARKER__POS] +
+        1 + 4;
 
     if (data == nullptr) {
-        return expected_size;
+        return header_size + CHUNK_CODEC_MAX_ENCODED_SIZE(2 * CHUNK_VOLUME);
     }
 
     size_t i = 0;
 
     // Write version
     data[i] = SER_MARKER__VERSION; i += 1;
-    *(uint32_t*)(&(data[i])) = EXPECTED_DATA_SIZES[SER_MARKER__VERSION]; i += 4;
-    *(uint32_t*)(&(data[i])) = FORMAT_VERSION; i += 4;
+    write_u32(&(data[i]), EXPECTED_DATA_SIZES[SER_MARKER__VERSION]); i += 4;
+    write_u32(&(data[i]), FORMAT_VERSION); i += 4;
 
     // Write pos
     data[i] = SER_MARKER__POS; i += 1;
-    *(uint32_t*)(&(data[i])) = EXPECTED_DATA_SIZES[SER_MARKER__POS]; i += 4;
-    *(uint64_t*)(&(data[i])) = self->pos[0]; i += 8;
-    *(uint64_t*)(&(data[i])) = self->pos[1]; i += 8;
-    *(uint64_t*)(&(data[i])) = self->pos[2]; i += 8;
-
-    // Write tiles
-    data[i] = SER_MARKER__TILES; i += 1;
-    *(uint32_t*)(&(data[i])) = EXPECTED_DATA_SIZES[SER_MARKER__TILES]; i += 4;
-    for (size_t j = 0; j < CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE; j++) {
-        data[i] = self->tiles[j];
-        i += 1;
+    write_u32(&(data[i]), EXPECTED_DATA_SIZES[SER_MARKER__POS]); i += 4;
+    // Sign-extended to 64 bits, matching the size_t positions older chunks were written with.
+    write_u64(&(data[i]), (uint64_t) (int64_t) self->pos[0]); i += 8;
+    write_u64(&(data[i]), (uint64_t) (int64_t) self->pos[1]); i += 8;
+    write_u64(&(data[i]), (uint64_t) (int64_t) self->pos[2]); i += 8;
+
+    // Write tiles followed by tile shapes, packed
+    uint8_t raw[2 * CHUNK_VOLUME];
+    for (size_t j = 0; j < CHUNK_VOLUME; j++) {
+        size_t const index = self->bits == 0 ? 0 : get_index(self, j);
+        raw[j] = self->palette_tiles[index];
+        raw[CHUNK_VOLUME + j] = self->palette_shapes[index];
     }
+    data[i] = SER_MARKER__PACKED; i += 1;
+    size_t const packed_size = chunk_codec_encode(raw, sizeof(raw), &(data[i + 4]));
+    write_u32(&(data[i]), (uint32_t) packed_size); i += 4;
+    i += packed_size;
 
-    // Write tile shapes
-    data[i] = SER_MARKER__TILE_SHAPES; i += 1;
-    *(uint32_t*)(&(data[i])) = EXPECTED_DATA_SIZES[SER_MARKER__TILE_SHAPES]; i += 4;
-    for (size_t j = 0; j < CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE; j++) {
-        data[i] = self->tile_shapes[j];
-        i += 1;
-    }
-
-    return expected_size;
+    return i;
 }
 
 chunk_t* const chunk_deserialize(size_t const data_size, uint8_t const data[data_size]) {
-    size_t expected_size = 0;
-    for (ser_marker_t marker = 0; marker < NUM_SER_MARKERS; marker++) {
-        expected_size += 1;
-        expected_size += 4;
-        expected_size += EXPECTED_DATA_SIZES[marker];
-    }
-
-    assert(data_size >= expected_size);
-
-    // Check we have all the appropriate markers
-    size_t num_markers[NUM_SER_MARKERS];
+    // Find where each marker's data starts, and check none is repeated
+    size_t num_markers[NUM_SER_MARKERS] = { 0 };
+    size_t offsets[NUM_SER_MARKERS] = { 0 };
+    size_t sizes[NUM_SER_MARKERS] = { 0 };
     size_t i = 0;
     while (i < data_size) {
-        ser_marker_t marker = (ser_marker_t) data[i];
+        if (data_size - i < 1 + 4) {
+            LOG_ERROR("Truncated marker at byte %zu!", i);
+            return nullptr;
+        }
+        ser_marker_t const marker = (ser_marker_t) data[i];
         if (marker >= NUM_SER_MARKERS) {
             LOG_ERROR("Invalid marker %zu at byte %zu!", (size_t) marker, i);
             return nullptr;
         }
+        size_t const marker_size = read_u32(&(data[i + 1]));
+        if (marker_size < EXPECTED_DATA_SIZES[marker] || marker_size > data_size - i - 1 - 4) {
+            LOG_ERROR("Bad data size %zu for marker %zu - expected %zu!", marker_size, (size_t) marker, EXPECTED_DATA_SIZES[marker]);
+            return nullptr;
+        }
         num_markers[marker]++;
-        i = i + 1 + 4;
-        i += *(uint32_t*)(&(data[i]));
+        offsets[marker] = i + 1 + 4;
+        sizes[marker] = marker_size;
+        i += 1 + 4 + marker_size;
     }
-    for (size_t j = 0; j < NUM_SER_MARKERS; j++) {
-        if (num_markers[j] != 1) {
-            LOG_ERROR("%zu instances of marker found!", num_markers[j]);
+    for (ser_marker_t marker = 0; marker < NUM_SER_MARKERS; marker++) {
+        if (num_markers[marker] > 1) {
+            LOG_ERROR("%zu instances of marker %zu found!", num_markers[marker], (size_t) marker);
             return nullptr;
         }
     }
+    if (num_markers[SER_MARKER__VERSION] != 1 || num_markers[SER_MARKER__POS] != 1) {
+        LOG_ERROR("Missing version or position marker!");
+        return nullptr;
+    }
 
-    chunk_t* chunk = chunk_new((size_chunks_t[NUM_AXES]) { 0, 0, 0 });
-
-    // Read from markers
-    i = 0;
-    while (i < data_size) {
-        ser_marker_t marker = (ser_marker_t) data[i]; i++;
-        size_t data_size = *(uint32_t*)(&(data[i])); i += 4;
-        if (data_size < EXPECTED_DATA_SIZES[marker]) {
-            LOG_ERROR("Data size for marker is too small - expected %zu, got %zu!", EXPECTED_DATA_SIZES[marker], data_size);
-        }
-        size_t j = i;
-        switch (marker) {
-            case SER_MARKER__POS: {
-                chunk->pos[AXIS__X] = *(uint64_t*)(&(data[j])); j += 8;
-                chunk->pos[AXIS__Y] = *(uint64_t*)(&(data[j])); j += 8;
-                chunk->pos[AXIS__Z] = *(uint64_t*)(&(data[j])); j += 8;
-                break;
-            }
-            case SER_MARKER__TILES: {
-                memcpy(chunk->tiles, &(data[j]), CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
-                break;
+    // Gather the tiles followed by the tile shapes
+    uint8_t raw[2 * CHUNK_VOLUME];
+    uint32_t const version = read_u32(&(data[offsets[SER_MARKER__VERSION]]));
+    switch (version) {
+        case 1: {
+            if (num_markers[SER_MARKER__TILES] != 1 || num_markers[SER_MARKER__TILE_SHAPES] != 1) {
+                LOG_ERROR("Missing tile or tile shape marker!");
+                return nullptr;
             }
-            case SER_MARKER__TILE_SHAPES: {
-                memcpy(chunk->tiles, &(data[j]), CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
-                break;
+            memcpy(raw, &(data[offsets[SER_MARKER__TILES]]), CHUNK_VOLUME);
+            memcpy(&(raw[CHUNK_VOLUME]), &(data[offsets[SER_MARKER__TILE_SHAPES]]), CHUNK_VOLUME);
+            break;
+        }
+        case 2: {
+            if (num_markers[SER_MARKER__PACKED] != 1 || !chunk_codec_decode(&(data[offsets[SER_MARKER__PACKED]]), sizes[SER_MARKER__PACKED], raw, sizeof(raw))) {
+                LOG_ERROR("Missing or corrupt packed marker!");
+                return nullptr;
             }
+            break;
+        }
+        default: {
+            LOG_ERROR("Unsupported chunk format version %u!", version);
+            return nullptr;
+        }
+    }
+
+    uint8_t const* const tiles = raw;
+    uint8_t const* const shapes = &(raw[CHUNK_VOLUME]);
+    for (size_t k = 0; k < CHUNK_VOLUME; k++) {
+        if (tiles[k] >= NUM_TILES || shapes[k] >= NUM_TILE_SHAPES) {
+            LOG_ERROR("Invalid tile %u with shape %u at index %zu!", tiles[k], shapes[k], k);
+            return nullptr;
         }
-        i += *(uint32_t*)(&(data[i]));
+    }
+
+    size_t const pos_offset = offsets[SER_MARKER__POS];
+    chunk_t* const chunk = chunk_new((pos_chunks_t[NUM_AXES]) {
+        (pos_chunks_t) (int64_t) read_u64(&(data[pos_offset])),
+        (pos_chunks_t) (int64_t) read_u64(&(data[pos_offset + 8])),
+        (pos_chunks_t) (int64_t) read_u64(&(data[pos_offset + 16]))
+    });
+
+    for (size_t k = 0; k < CHUNK_VOLUME; k++) {
+        set_entry(chunk, k, tiles[k], shapes[k]);
     }
 
     return chunk;
-}
\ No newline at end of file
+}
+
+// Serialized fields are little-endian and not necessarily aligned.
+static uint32_t const read_u32(uint8_t const* const data) {
+    return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static uint64_t const read_u64(uint8_t const* const data) {
+    return (uint64_t) read_u32(data) | ((uint64_t) read_u32(&(data[4])) << 32);
+}
+
+static void write_u32(uint8_t* const data, uint32_t const value) {
+    data[0] = (uint8_t) value;
+    data[1] = (uint8_t) (value >> 8);
+    data[2] = (uint8_t) (value >> 16);
+    data[3] = (uint8_t) (value >> 24);
+}
+
+static void write_u64(uint8_t* const data, uint64_t const value) {
+    write_u32(data, (uint32_t) value);
+    write_u32(&(data[4]), (uint32_t) (value >> 32));
+}
+
+static size_t const get_index(chunk_t const* const self, size_t const i) {
+    size_t const bit = i * self->bits;
+
+    return (self->indices[bit / 8] >> (bit % 8)) & ((1u << self->bits) - 1);
+}
+
+static void set_index(chunk_t* const self, size_t const i, size_t const index) {
+    size_t const bit = i * self->bits;
+    uint8_t const mask = (uint8_t) (((1u << self->bits) - 1) << (bit % 8));
+
+    self->indices[bit / 8] = (self->indices[bit / 8] & ~mask) | ((uint8_t) (index << (bit % 8)) & mask);
+}
+
+static size_t const find_or_add_palette_entry(chunk_t* const self, tile_t const tile, tile_shape_t const shape) {
+    size_t free_entry = self->palette_size;
+    for (size_t i = 0; i < self->palette_size; i++) {
+        if (self->palette_tiles[i] == tile && self->palette_shapes[i] == shape) {
+            return i;
+        }
+        if (self->palette_refs[i] == 0 && free_entry == self->palette_size) {
+            free_entry = i;
+        }
+    }
+
+    if (free_entry == self->palette_size) {
+        assert(self->palette_size < MAX_PALETTE_SIZE);
+        if (self->palette_size == (1u << self->bits)) {
+            grow_indices(self);
+        }
+        self->palette_size++;
+    }
+
+    self->palette_tiles[free_entry] = tile;
+    self->palette_shapes[free_entry] = shape;
+    self->palette_refs[free_entry] = 0;
+
+    return free_entry;
+}
+
+static void create_arenas(void) {
+    chunk_arena = chunk_arena_new(sizeof(chunk_t));
+    for (uint8_t bits = 1; bits <= 8; bits *= 2) {
+        indices_arenas[bits] = chunk_arena_new(INDICES_HEADER_SIZE + INDICES_SIZE(bits));
+    }
+}
+
+static uint8_t* const alloc_indices(uint8_t const bits) {
+    assert(bits == 1 || bits == 2 || bits == 4 || bits == 8);
+
+    uint8_t* const slot = chunk_arena_alloc(indices_arenas[bits]);
+    assert(slot != nullptr);
+
+    uint8_t* const indices = slot + INDICES_HEADER_SIZE;
+    INDICES_REFS(indices) = 1;
+    INDICES_BITS(indices) = bits;
+    memset(indices, 0, INDICES_SIZE(bits));
+
+    return indices;
+}
+
+static void release_indices(uint8_t const bits, uint8_t* const indices) {
+    assert(bits == 1 || bits == 2 || bits == 4 || bits == 8);
+    assert(indices_arenas[bits] != nullptr);
+    assert(INDICES_REFS(indices) > 0);
+
+    INDICES_REFS(indices)--;
+    if (INDICES_REFS(indices) == 0) {
+        chunk_arena_free(indices_arenas[bits], indices - INDICES_HEADER_SIZE);
+    }
+}
+
+static void unshare_indices(chunk_t* const self) {
+    if (self->indices == UNIFORM_INDICES || INDICES_REFS(self->indices) == 1) {
+        return;
+    }
+
+    uint8_t* const indices = alloc_indices(self->bits);
+    memcpy(indices, self->indices, INDICES_SIZE(self->bits));
+
+    release_indices(self->bits, self->indices);
+    self->indices = indices;
+}
+
+static void grow_indices(chunk_t* const self) {
+    assert(self->bits < 8);
+
+    chunk_t old = *self;
+
+    self->bits = self->bits == 0 ? 1 : self->bits * 2;
+    self->indices = alloc_indices(self->bits);
+
+    if (old.bits > 0) {
+        for (size_t i = 0; i < CHUNK_VOLUME; i++) {
+            set_index(self, i, get_index(&old, i));
+        }
+
+        release_indices(old.bits, old.indices);
+    }
+}
+
+static void make_uniform(chunk_t* const self, size_t const index) {
+    assert(self->palette_refs[index] == CHUNK_VOLUME);
+
+    self->palette_tiles[0] = self->palette_tiles[index];
+    self->palette_shapes[0] = self->palette_shapes[index];
+    self->palette_refs[0] = CHUNK_VOLUME;
+    self->palette_size = 1;
+
+    if (self->indices != UNIFORM_INDICES) {
+        release_indices(self->bits, self->indices);
+    }
+    self->bits = 0;
+    self->indices = (uint8_t*) UNIFORM_INDICES;
+}
+
+static void set_entry(chunk_t* const self, size_t const i, tile_t const tile, tile_shape_t const shape) {
+    size_t const old_index = get_index(self, i);
+    if (self->palette_tiles[old_index] == tile && self->palette_shapes[old_index] == shape) {
+        return;
+    }
+
+    size_t const new_index = find_or_add_palette_entry(self, tile, shape);
+
+    unshare_indices(self);
+    set_index(self, i, new_index);
+    self->palette_refs[old_index]--;
+    self->palette_refs[new_index]++;
+    self->tile_counts[self->palette_tiles[old_index]]--;
+    self->tile_counts[tile]++;
+
+    size_t const row = i / CHUNK_SIZE;
+    chunk_row_t const bit = (chunk_row_t) (1u << (i % CHUNK_SIZE));
+    if (tile != TILE__AIR) {
+        self->occupancy[row] |= bit;
+    } else {
+        self->occupancy[row] &= (chunk_row_t) ~bit;
+    }
+    if (self->palette_shapes[old_index] != shape) {
+        for (side_t side = 0; side < NUM_SIDES; side++) {
+            if (tile_shape_can_side_occlude(shape, side)) {
+                self->full_faces[side][row] |= bit;
+            } else {
+                self->full_faces[side][row] &= (chunk_row_t) ~bit;
+            }
+        }
+    }
+
+    if (self->palette_refs[new_index] == CHUNK_VOLUME) {
+        make_uniform(self, new_index);
+    }
+}
+
+static void begin_write(chunk_t* const self) {
+    unsigned const sequence = atomic_load_explicit(&(self->sequence), memory_order_relaxed);
+    atomic_store_explicit(&(self->sequence), sequence + 1, memory_order_relaxed);
+    // Readers that see any of the writes below also see the odd sequence.
+    atomic_thread_fence(memory_order_release);
+}
+
+static void end_write(chunk_t* const self) {
+    unsigned const sequence = atomic_load_explicit(&(self->sequence), memory_order_relaxed);
+    atomic_store_explicit(&(self->sequence), sequence + 1, memory_order_release);
+}
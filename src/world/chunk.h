@@ -1,20 +1,47 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "src/world/tile.h"
 #include "src/world/tile_shape.h"
 #include "src/world/side.h"
 
 #define CHUNK_SIZE 16
 
+// Chunk coordinate holding a signed tile coordinate, rounding towards negative infinity.
+#define CHUNK_COORD(tile_coord) (((tile_coord) >= 0 ? (tile_coord) : (tile_coord) - (CHUNK_SIZE - 1)) / CHUNK_SIZE)
+
+// Position of a signed tile coordinate within its chunk.
+#define CHUNK_LOCAL(tile_coord) ((size_t) ((tile_coord) - (CHUNK_COORD(tile_coord) * CHUNK_SIZE)))
+
+// Index of the row of tiles at (y, z) in a chunk mask.
+#define CHUNK_ROW(y, z) (((y) * CHUNK_SIZE) + (z))
+
 typedef size_t size_chunks_t;
 
+// Signed chunk coordinate, used where a world position may lie below zero.
+typedef int32_t pos_chunks_t;
+
+// Signed tile coordinate, used where a world position may lie below zero.
+typedef ptrdiff_t pos_tiles_t;
+
 typedef struct chunk chunk_t;
 
-chunk_t* const chunk_new(size_chunks_t const pos[NUM_AXES]);
+// One bit per tile along X, bit 0 being X = 0. A chunk mask holds CHUNK_SIZE * CHUNK_SIZE rows, indexed by CHUNK_ROW.
+typedef uint16_t chunk_row_t;
+
+// Deletes the arenas every chunk is allocated from. Call once at shutdown, after every chunk and snapshot has been deleted.
+void chunks_cleanup(void);
+
+chunk_t* const chunk_new(pos_chunks_t const pos[NUM_AXES]);
 
 void chunk_delete(chunk_t* const self);
 
-void chunk_get_pos(chunk_t const* const self, size_chunks_t pos[NUM_AXES]);
+// Returns a copy that shares storage with the chunk until either is written to.
+chunk_t* const chunk_snapshot(chunk_t const* const self);
+
+void chunk_get_pos(chunk_t const* const self, pos_chunks_t pos[NUM_AXES]);
 
 tile_t const chunk_get_tile(chunk_t const* const self, size_t const pos[NUM_AXES]);
 
@@ -23,3 +50,37 @@ void chunk_set_tile(chunk_t* const self, size_t const pos[NUM_AXES], tile_t cons
 tile_shape_t const chunk_get_tile_shape(chunk_t const* const self, size_t const pos[NUM_AXES]);
 
 void chunk_set_tile_shape(chunk_t* const self, size_t const pos[NUM_AXES], tile_shape_t const shape);
+
+void chunk_read_region(chunk_t const* const self, size_t const min[NUM_AXES], size_t const max[NUM_AXES], size_t const strides[NUM_AXES], tile_t* const tiles, tile_shape_t* const shapes);
+
+void chunk_write_region(chunk_t* const self, size_t const min[NUM_AXES], size_t const max[NUM_AXES], size_t const strides[NUM_AXES], tile_t const* const tiles, tile_shape_t const* const shapes);
+
+size_t const chunk_get_tile_count(chunk_t const* const self, tile_t const tile);
+
+bool const chunk_is_uniform(chunk_t const* const self);
+
+bool const chunk_is_empty(chunk_t const* const self);
+
+// Starts an optimistic read from any thread, waiting out a write in progress. Returns the sequence to validate against.
+// Reads between this and chunk_read_validate may see torn state, and must not be trusted until validated.
+unsigned const chunk_read_begin(chunk_t const* const self);
+
+// True if no write overlapped the read started with chunk_read_begin. Otherwise the read has to be retried.
+bool const chunk_read_validate(chunk_t const* const self, unsigned const sequence);
+
+// Copies every tile and tile shape in the same order as chunk_read_region over the whole chunk, and the occupancy mask
+// as of the same moment. Any of the buffers may be nullptr.
+// Safe to call from any thread while the owning thread writes to the chunk, as long as the chunk is not deleted meanwhile.
+void chunk_read_snapshot(chunk_t const* const self, tile_t* const tiles, tile_shape_t* const shapes, chunk_row_t* const occupancy);
+
+// Mask of the non-air tiles. Kept up to date on every write.
+chunk_row_t const* const chunk_get_occupancy(chunk_t const* const self);
+
+// Mask of the tiles whose shape covers the whole of the given side, and so hides the neighbouring face there.
+chunk_row_t const* const chunk_get_full_faces(chunk_t const* const self, side_t const side);
+
+// Returns the serialized size. If data is nullptr, nothing is written and an upper bound on the size is returned instead.
+size_t const chunk_serialize(chunk_t const* const self, uint8_t* const data);
+
+// Returns nullptr if the data is not a valid serialized chunk.
+chunk_t* const chunk_deserialize(size_t const data_size, uint8_t const data[data_size]);
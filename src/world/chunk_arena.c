@@ -0,0 +1,173 @@
+// Needed for MAP_ANONYMOUS and madvise under strict C.
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include "./chunk_arena.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+#include "src/util/logger.h"
+#include "src/util/object_counter.h"
+
+// One transparent huge page on x86-64 and aarch64.
+#define SLAB_SIZE (2 * 1024 * 1024)
+#define SLOT_ALIGNMENT 64
+
+/* LAYOUT:
+ *     Slots are carved out of SLAB_SIZE slabs in address order, so chunks
+ *     created together (e.g. a freshly generated column) sit next to each
+ *     other in memory. Freed slots go onto an intrusive LIFO free list and
+ *     are handed out again before any untouched slot. Slabs are only
+ *     returned to the system when the arena itself is deleted.
+ *
+ *     Allocating and freeing take a short lock, so chunks can be created
+ *     on several threads at once.
+ */
+
+struct chunk_arena {
+    pthread_mutex_t lock;
+    size_t slot_size;
+    size_t num_live;
+    void** slabs;
+    size_t num_slabs;
+    size_t slabs_capacity;
+    uint8_t* next_slot;
+    uint8_t* slab_end;
+    void* free_list;
+};
+
+static void* const map_slab(void);
+static void unmap_slab(void* const slab);
+
+chunk_arena_t* const chunk_arena_new(size_t const slot_size) {
+    assert(slot_size > 0 && slot_size <= SLAB_SIZE);
+
+    chunk_arena_t* const self = malloc(sizeof(chunk_arena_t));
+    assert(self != nullptr);
+
+    pthread_mutex_init(&(self->lock), nullptr);
+    self->slot_size = (slot_size + SLOT_ALIGNMENT - 1) & ~((size_t) SLOT_ALIGNMENT - 1);
+    self->num_live = 0;
+    self->slabs = nullptr;
+    self->num_slabs = 0;
+    self->slabs_capacity = 0;
+    self->next_slot = nullptr;
+    self->slab_end = nullptr;
+    self->free_list = nullptr;
+
+    OBJ_CTR_INC(chunk_arena_t);
+
+    return self;
+}
+
+void chunk_arena_delete(chunk_arena_t* const self) {
+    assert(self != nullptr);
+
+    if (self->num_live > 0) {
+        LOG_WARN("chunk_arena_t: deleting arena with %zu live slots.", self->num_live);
+    }
+
+    for (size_t i = 0; i < self->num_slabs; i++) {
+        unmap_slab(self->slabs[i]);
+    }
+    free(self->slabs);
+    pthread_mutex_destroy(&(self->lock));
+    free(self);
+
+    OBJ_CTR_DEC(chunk_arena_t);
+}
+
+void* const chunk_arena_alloc(chunk_arena_t* const self) {
+    assert(self != nullptr);
+
+    pthread_mutex_lock(&(self->lock));
+
+    self->num_live++;
+
+    void* slot = self->free_list;
+    if (slot != nullptr) {
+        self->free_list = *((void**) slot);
+    } else {
+        if (self->next_slot == nullptr || self->next_slot + self->slot_size > self->slab_end) {
+            if (self->num_slabs == self->slabs_capacity) {
+                self->slabs_capacity = self->slabs_capacity == 0 ? 4 : self->slabs_capacity * 2;
+                self->slabs = realloc(self->slabs, sizeof(void*) * self->slabs_capacity);
+                assert(self->slabs != nullptr);
+            }
+            uint8_t* const slab = map_slab();
+            self->slabs[self->num_slabs++] = slab;
+            self->next_slot = slab;
+            self->slab_end = slab + SLAB_SIZE;
+        }
+
+        slot = self->next_slot;
+        self->next_slot += self->slot_size;
+    }
+
+    pthread_mutex_unlock(&(self->lock));
+
+    return slot;
+}
+
+void chunk_arena_free(chunk_arena_t* const self, void* const slot) {
+    assert(self != nullptr);
+    assert(slot != nullptr);
+
+    pthread_mutex_lock(&(self->lock));
+
+    assert(self->num_live > 0);
+
+    *((void**) slot) = self->free_list;
+    self->free_list = slot;
+    self->num_live--;
+
+    pthread_mutex_unlock(&(self->lock));
+}
+
+size_t const chunk_arena_get_num_live(chunk_arena_t const* const self) {
+    assert(self != nullptr);
+
+    return self->num_live;
+}
+
+static void* const map_slab(void) {
+#if defined(_WIN32)
+    void* const slab = malloc(SLAB_SIZE);
+    assert(slab != nullptr);
+
+    return slab;
+#else
+    // Over-map by a slab so the returned range can start on a huge page boundary.
+    uint8_t* const region = mmap(nullptr, SLAB_SIZE * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(region != MAP_FAILED);
+
+    uint8_t* const slab = (uint8_t*) (((uintptr_t) region + SLAB_SIZE - 1) & ~((uintptr_t) SLAB_SIZE - 1));
+    size_t const head = slab - region;
+    if (head > 0) {
+        munmap(region, head);
+    }
+    munmap(slab + SLAB_SIZE, SLAB_SIZE - head);
+
+#if defined(MADV_HUGEPAGE)
+    madvise(slab, SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+
+    return slab;
+#endif
+}
+
+static void unmap_slab(void* const slab) {
+#if defined(_WIN32)
+    free(slab);
+#else
+    munmap(slab, SLAB_SIZE);
+#endif
+}
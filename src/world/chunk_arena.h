@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+
+typedef struct chunk_arena chunk_arena_t;
+
+chunk_arena_t* const chunk_arena_new(size_t const slot_size);
+
+void chunk_arena_delete(chunk_arena_t* const self);
+
+void* const chunk_arena_alloc(chunk_arena_t* const self);
+
+void chunk_arena_free(chunk_arena_t* const self, void* const slot);
+
+size_t const chunk_arena_get_num_live(chunk_arena_t const* const self);
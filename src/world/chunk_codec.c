@@ -0,0 +1,222 @@
+#include "./chunk_codec.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define USE_SSE2 1
+#endif
+
+#define MAX_RUNS_SIZE (2 * CHUNK_CODEC_MAX_INPUT_SIZE)
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_MATCH (0x7f + LZ_MIN_MATCH)
+#define LZ_MAX_LITERALS 0x80
+#define LZ_HASH_BITS 12
+
+/* ENCODING:
+ *     The input is first split into runs of equal bytes, each written as
+ *     the byte followed by the run length minus one as a little-endian
+ *     base-128 varint. Chunk data is in Y-major order, so the flat layers
+ *     of generated terrain become a handful of long runs.
+ *
+ *     The runs are then LZ-compressed, which catches rows and layers that
+ *     repeat without being uniform. Each LZ token starts with a control
+ *     byte:
+ *         0nnnnnnn: n + 1 literal bytes follow.
+ *         1nnnnnnn: copy n + LZ_MIN_MATCH bytes from a 2-byte little-endian
+ *                   distance back in the output.
+ */
+
+static size_t const find_run_length(uint8_t const* const src, size_t const start, size_t const size);
+static size_t const rle_encode(uint8_t const* const src, size_t const size, uint8_t* const dst);
+static bool const rle_decode(uint8_t const* const src, size_t const src_size, uint8_t* const dst, size_t const size);
+static size_t const lz_encode(uint8_t const* const src, size_t const size, uint8_t* const dst);
+static size_t const lz_decode(uint8_t const* const src, size_t const src_size, uint8_t* const dst, size_t const capacity);
+static size_t const flush_literals(uint8_t const* const src, size_t const start, size_t const end, uint8_t* const dst);
+
+size_t const chunk_codec_encode(uint8_t const* const src, size_t const size, uint8_t* const dst) {
+    assert(src != nullptr);
+    assert(size <= CHUNK_CODEC_MAX_INPUT_SIZE);
+    assert(dst != nullptr);
+
+    uint8_t runs[MAX_RUNS_SIZE];
+    size_t const runs_size = rle_encode(src, size, runs);
+
+    return lz_encode(runs, runs_size, dst);
+}
+
+bool const chunk_codec_decode(uint8_t const* const src, size_t const src_size, uint8_t* const dst, size_t const size) {
+    assert(src != nullptr);
+    assert(dst != nullptr);
+    assert(size <= CHUNK_CODEC_MAX_INPUT_SIZE);
+
+    uint8_t runs[MAX_RUNS_SIZE];
+    size_t const runs_size = lz_decode(src, src_size, runs, sizeof(runs));
+    if (runs_size == 0 && src_size != 0) {
+        return false;
+    }
+
+    return rle_decode(runs, runs_size, dst, size);
+}
+
+static size_t const find_run_length(uint8_t const* const src, size_t const start, size_t const size) {
+    uint8_t const value = src[start];
+    size_t i = start + 1;
+
+#if USE_SSE2
+    // Compare 16 bytes at a time; the first mismatching lane ends the run.
+    __m128i const needle = _mm_set1_epi8((char) value);
+    while (i + 16 <= size) {
+        unsigned const mask = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*) &(src[i])), needle));
+        if (mask != 0xFFFF) {
+            return i + (size_t) __builtin_ctz(~mask) - start;
+        }
+        i += 16;
+    }
+#endif
+
+    while (i < size && src[i] == value) {
+        i++;
+    }
+
+    return i - start;
+}
+
+static size_t const rle_encode(uint8_t const* const src, size_t const size, uint8_t* const dst) {
+    size_t out = 0;
+    size_t i = 0;
+    while (i < size) {
+        size_t const length = find_run_length(src, i, size);
+
+        dst[out++] = src[i];
+        size_t remaining = length - 1;
+        while (remaining >= 0x80) {
+            dst[out++] = (uint8_t) (remaining | 0x80);
+            remaining >>= 7;
+        }
+        dst[out++] = (uint8_t) remaining;
+
+        i += length;
+    }
+
+    return out;
+}
+
+static bool const rle_decode(uint8_t const* const src, size_t const src_size, uint8_t* const dst, size_t const size) {
+    size_t out = 0;
+    size_t i = 0;
+    while (i < src_size) {
+        uint8_t const value = src[i++];
+
+        size_t length = 0;
+        for (size_t shift = 0; ; shift += 7) {
+            if (i >= src_size || shift > 21) {
+                return false;
+            }
+            uint8_t const byte = src[i++];
+            length |= (size_t) (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        length++;
+
+        if (length > size - out) {
+            return false;
+        }
+        memset(&(dst[out]), value, length);
+        out += length;
+    }
+
+    return out == size;
+}
+
+static size_t const lz_encode(uint8_t const* const src, size_t const size, uint8_t* const dst) {
+    // Most recent position of each hashed 4-byte sequence, or -1.
+    int32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0xff, sizeof(table));
+
+    size_t out = 0;
+    size_t literals_start = 0;
+    size_t i = 0;
+    while (i + LZ_MIN_MATCH <= size) {
+        uint32_t sequence;
+        memcpy(&sequence, &(src[i]), sizeof(sequence));
+        size_t const hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+        int32_t const candidate = table[hash];
+        table[hash] = (int32_t) i;
+
+        if (candidate < 0 || i - (size_t) candidate > 0xFFFF || memcmp(&(src[candidate]), &(src[i]), LZ_MIN_MATCH) != 0) {
+            i++;
+            continue;
+        }
+
+        size_t length = LZ_MIN_MATCH;
+        while (i + length < size && length < LZ_MAX_MATCH && src[(size_t) candidate + length] == src[i + length]) {
+            length++;
+        }
+
+        out += flush_literals(src, literals_start, i, &(dst[out]));
+
+        size_t const distance = i - (size_t) candidate;
+        dst[out++] = (uint8_t) (0x80 | (length - LZ_MIN_MATCH));
+        dst[out++] = (uint8_t) distance;
+        dst[out++] = (uint8_t) (distance >> 8);
+
+        i += length;
+        literals_start = i;
+    }
+
+    out += flush_literals(src, literals_start, size, &(dst[out]));
+
+    return out;
+}
+
+static size_t const lz_decode(uint8_t const* const src, size_t const src_size, uint8_t* const dst, size_t const capacity) {
+    size_t out = 0;
+    size_t i = 0;
+    while (i < src_size) {
+        uint8_t const control = src[i++];
+        if ((control & 0x80) != 0) {
+            size_t const length = (size_t) (control & 0x7f) + LZ_MIN_MATCH;
+            if (src_size - i < 2) {
+                return 0;
+            }
+            size_t const distance = (size_t) src[i] | ((size_t) src[i + 1] << 8);
+            i += 2;
+            if (distance == 0 || distance > out || length > capacity - out) {
+                return 0;
+            }
+            // Matches may overlap their own output, so copy forwards a byte at a time.
+            for (size_t j = 0; j < length; j++) {
+                dst[out + j] = dst[out - distance + j];
+            }
+            out += length;
+        } else {
+            size_t const length = (size_t) control + 1;
+            if (length > src_size - i || length > capacity - out) {
+                return 0;
+            }
+            memcpy(&(dst[out]), &(src[i]), length);
+            i += length;
+            out += length;
+        }
+    }
+
+    return out;
+}
+
+static size_t const flush_literals(uint8_t const* const src, size_t const start, size_t const end, uint8_t* const dst) {
+    size_t out = 0;
+    for (size_t i = start; i < end; ) {
+        size_t const length = end - i < LZ_MAX_LITERALS ? end - i : LZ_MAX_LITERALS;
+        dst[out++] = (uint8_t) (length - 1);
+        memcpy(&(dst[out]), &(src[i]), length);
+        out += length;
+        i += length;
+    }
+
+    return out;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/world/chunk.h"
+
+// Largest input the codec accepts: the tiles and tile shapes of one chunk.
+#define CHUNK_CODEC_MAX_INPUT_SIZE (2 * CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+
+// Upper bound on the encoded size of size bytes of input.
+#define CHUNK_CODEC_MAX_ENCODED_SIZE(size) ((2 * (size)) + (((2 * (size)) + 127) / 128))
+
+// Run-length encodes the data, then LZ-compresses the runs. Returns the encoded size.
+// dst must hold CHUNK_CODEC_MAX_ENCODED_SIZE(size) bytes.
+size_t const chunk_codec_encode(uint8_t const* const src, size_t const size, uint8_t* const dst);
+
+// Returns false unless the data is well formed and decodes to exactly size bytes.
+bool const chunk_codec_decode(uint8_t const* const src, size_t const src_size, uint8_t* const dst, size_t const size);
@@ -0,0 +1,178 @@
+#include "./chunk_map.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/util/object_counter.h"
+
+#define MIN_CAPACITY 16
+// Grow once the table is more than three quarters full.
+#define NEEDS_GROW(size, capacity) (((size) + 1) * 4 > (capacity) * 3)
+
+/* LAYOUT:
+ *     Open addressing with linear probing over a power-of-two table. A slot
+ *     is empty when its value is nullptr, so stored values must be non-null.
+ *     Removal shifts the following probe run back instead of leaving
+ *     tombstones, which keeps lookups short on long-running levels.
+ */
+
+typedef struct entry {
+    pos_chunks_t pos[NUM_AXES];
+    void* value;
+} entry_t;
+
+struct chunk_map {
+    size_t size;
+    size_t capacity;
+    entry_t* entries;
+};
+
+static size_t const hash(pos_chunks_t const pos[NUM_AXES]);
+static size_t const find_slot(chunk_map_t const* const self, pos_chunks_t const pos[NUM_AXES]);
+static void grow(chunk_map_t* const self);
+
+chunk_map_t* const chunk_map_new(size_t const initial_capacity) {
+    chunk_map_t* const self = malloc(sizeof(chunk_map_t));
+    assert(self != nullptr);
+
+    size_t capacity = MIN_CAPACITY;
+    while (capacity < initial_capacity) {
+        capacity *= 2;
+    }
+
+    self->size = 0;
+    self->capacity = capacity;
+    self->entries = calloc(capacity, sizeof(entry_t));
+    assert(self->entries != nullptr);
+
+    OBJ_CTR_INC(chunk_map_t);
+
+    return self;
+}
+
+void chunk_map_delete(chunk_map_t* const self) {
+    assert(self != nullptr);
+
+    free(self->entries);
+    free(self);
+
+    OBJ_CTR_DEC(chunk_map_t);
+}
+
+size_t const chunk_map_get_size(chunk_map_t const* const self) {
+    assert(self != nullptr);
+
+    return self->size;
+}
+
+void* const chunk_map_get(chunk_map_t const* const self, pos_chunks_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+
+    return self->entries[find_slot(self, pos)].value;
+}
+
+void chunk_map_put(chunk_map_t* const self, pos_chunks_t const pos[NUM_AXES], void* const value) {
+    assert(self != nullptr);
+    assert(value != nullptr);
+
+    size_t slot = find_slot(self, pos);
+    if (self->entries[slot].value == nullptr) {
+        if (NEEDS_GROW(self->size, self->capacity)) {
+            grow(self);
+            slot = find_slot(self, pos);
+        }
+        memcpy(self->entries[slot].pos, pos, sizeof(pos_chunks_t) * NUM_AXES);
+        self->size++;
+    }
+
+    self->entries[slot].value = value;
+}
+
+void* const chunk_map_remove(chunk_map_t* const self, pos_chunks_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+
+    size_t const mask = self->capacity - 1;
+    size_t i = find_slot(self, pos);
+    void* const value = self->entries[i].value;
+    if (value == nullptr) {
+        return nullptr;
+    }
+
+    // Pull back any later entry whose home slot does not lie between the hole and itself.
+    for (size_t j = (i + 1) & mask; self->entries[j].value != nullptr; j = (j + 1) & mask) {
+        size_t const home = hash(self->entries[j].pos) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            self->entries[i] = self->entries[j];
+            i = j;
+        }
+    }
+    self->entries[i].value = nullptr;
+    self->size--;
+
+    return value;
+}
+
+bool const chunk_map_next(chunk_map_t const* const self, size_t* const iter, pos_chunks_t pos[NUM_AXES], void** const value) {
+    assert(self != nullptr);
+    assert(iter != nullptr);
+
+    for (; *iter < self->capacity; (*iter)++) {
+        entry_t const* const entry = &(self->entries[*iter]);
+        if (entry->value != nullptr) {
+            if (pos != nullptr) {
+                memcpy(pos, entry->pos, sizeof(pos_chunks_t) * NUM_AXES);
+            }
+            if (value != nullptr) {
+                *value = entry->value;
+            }
+            (*iter)++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static size_t const hash(pos_chunks_t const pos[NUM_AXES]) {
+    uint64_t h = (uint32_t) pos[AXIS__X];
+    h = (h * 0x9E3779B97F4A7C15ULL) ^ (uint32_t) pos[AXIS__Y];
+    h = (h * 0x9E3779B97F4A7C15ULL) ^ (uint32_t) pos[AXIS__Z];
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 32;
+
+    return (size_t) h;
+}
+
+static size_t const find_slot(chunk_map_t const* const self, pos_chunks_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+
+    size_t const mask = self->capacity - 1;
+    size_t slot = hash(pos) & mask;
+    while (self->entries[slot].value != nullptr && memcmp(self->entries[slot].pos, pos, sizeof(pos_chunks_t) * NUM_AXES) != 0) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void grow(chunk_map_t* const self) {
+    assert(self != nullptr);
+
+    entry_t* const old_entries = self->entries;
+    size_t const old_capacity = self->capacity;
+
+    self->capacity = old_capacity * 2;
+    self->entries = calloc(self->capacity, sizeof(entry_t));
+    assert(self->entries != nullptr);
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_entries[i].value != nullptr) {
+            size_t const slot = find_slot(self, old_entries[i].pos);
+            self->entries[slot] = old_entries[i];
+        }
+    }
+
+    free(old_entries);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/world/chunk.h"
+#include "src/world/side.h"
+
+typedef struct chunk_map chunk_map_t;
+
+chunk_map_t* const chunk_map_new(size_t const initial_capacity);
+
+void chunk_map_delete(chunk_map_t* const self);
+
+size_t const chunk_map_get_size(chunk_map_t const* const self);
+
+void* const chunk_map_get(chunk_map_t const* const self, pos_chunks_t const pos[NUM_AXES]);
+
+void chunk_map_put(chunk_map_t* const self, pos_chunks_t const pos[NUM_AXES], void* const value);
+
+void* const chunk_map_remove(chunk_map_t* const self, pos_chunks_t const pos[NUM_AXES]);
+
+bool const chunk_map_next(chunk_map_t const* const self, size_t* const iter, pos_chunks_t pos[NUM_AXES], void** const value);
@@ -1,7 +1,9 @@
 #include "./ecs.h"
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "src/util/object_counter.h"
 #include "src/world/entity/ecs_components.h"
@@ -9,9 +11,25 @@
 
 #define MAX_ENTITIES 1024
 
-typedef struct entity_storage {
-    void* component_data[NUM_ECS_COMPONENTS];
-} entity_storage_t;
+/* COMPONENT POOLS:
+ *     Each component type keeps its data packed in one array, with the
+ *     entity owning each slot alongside it, and a sparse array mapping each
+ *     entity to its slot. An entity has the component if its sparse entry
+ *     points back at a slot owned by it, so the sparse array never needs
+ *     clearing. Detaching moves the last slot into the hole, keeping the
+ *     data packed, so systems walk their component's entities in order over
+ *     contiguous memory instead of visiting every entity ID.
+ *
+ *     Pools are allocated at full size up front, so component data only
+ *     moves when a component of the same type is detached.
+ */
+
+typedef struct component_pool {
+    size_t size;
+    size_t sparse[MAX_ENTITIES];
+    entity_t entities[MAX_ENTITIES];
+    uint8_t* data;
+} component_pool_t;
 
 typedef struct system_storage {
     ecs_component_t target;
@@ -19,7 +37,8 @@ typedef struct system_storage {
 } system_storage_t;
 
 struct ecs {
-    entity_storage_t* entities[MAX_ENTITIES];
+    bool entities[MAX_ENTITIES];
+    component_pool_t pools[NUM_ECS_COMPONENTS];
     size_t systems_size;
     system_storage_t** systems;
     entity_t highest_entity_id;
@@ -36,14 +55,21 @@ static size_t const COMPONENT_SIZES[NUM_ECS_COMPONENTS] = {
     [ECS_COMPONENT__CONTROLLED] = sizeof(ecs_component_controlled_t)
 };
 
-static void* const new_component(ecs_component_t const component);
+static bool const is_in_pool(component_pool_t const* const pool, entity_t const entity);
 
-static void delete_component(ecs_component_t const component, void* const data);
+static void init_component(ecs_component_t const component, void* const data);
+
+static void clean_up_component(ecs_component_t const component, void* const data);
 
 ecs_t* const ecs_new(void) {
     ecs_t* self = calloc(1, sizeof(ecs_t));
     assert(self != nullptr);
 
+    for (ecs_component_t i = 0; i < NUM_ECS_COMPONENTS; i++) {
+        self->pools[i].data = malloc(COMPONENT_SIZES[i] * MAX_ENTITIES);
+        assert(self->pools[i].data != nullptr);
+    }
+
     OBJ_CTR_INC(ecs_t);
 
     return self;
@@ -53,11 +79,15 @@ void ecs_delete(ecs_t* const self) {
     assert(self != nullptr);
 
     for (size_t i = 0; i < MAX_ENTITIES; i++) {
-        if (self->entities[i] != nullptr) {
+        if (self->entities[i]) {
             ecs_delete_entity(self, i);
         }
     }
 
+    for (ecs_component_t i = 0; i < NUM_ECS_COMPONENTS; i++) {
+        free(self->pools[i].data);
+    }
+
     if (self->systems != nullptr) {
         for (size_t i = 0; i < self->systems_size; i++) {
             free(self->systems[i]);
@@ -74,15 +104,13 @@ void ecs_tick(ecs_t* const self, level_t* const level) {
     assert(self != nullptr);
     assert(level != nullptr);
 
-    for (entity_t entity = 0; entity < MAX_ENTITIES; entity++) {
-        if (self->entities[entity] != nullptr) {
-            for (size_t i = 0; i < self->systems_size; i++) {
-                if (self->systems[i] != nullptr) {
-                    system_storage_t const* const system_storage = self->systems[i];
-                    if (ecs_has_component(self, entity, system_storage->target)) {
-                        system_storage->system(self, level, entity);
-                    }
-                }
+    // Each entity still sees the systems in the order they were attached, as systems only touch the entity they are given.
+    for (size_t i = 0; i < self->systems_size; i++) {
+        if (self->systems[i] != nullptr) {
+            system_storage_t const* const system_storage = self->systems[i];
+            component_pool_t const* const pool = &(self->pools[system_storage->target]);
+            for (size_t j = 0; j < pool->size; j++) {
+                system_storage->system(self, level, pool->entities[j]);
             }
         }
     }
@@ -94,7 +122,7 @@ entity_t const ecs_new_entity(ecs_t* const self) {
     bool found_slot = false;
     entity_t entity = 0;
     for (entity_t i = 0; i < MAX_ENTITIES; i++) {
-        if (self->entities[i] == nullptr) {
+        if (!self->entities[i]) {
             entity = i;
             found_slot = true;
             break;
@@ -106,83 +134,84 @@ entity_t const ecs_new_entity(ecs_t* const self) {
         self->highest_entity_id = entity;
     }
 
-    entity_storage_t* entity_storage = calloc(1, sizeof(entity_storage_t));
-    assert(entity_storage != nullptr);
-
-    self->entities[entity] = entity_storage;
-
-    OBJ_CTR_INC(entity_storage_t);
+    self->entities[entity] = true;
 
     return entity;
 }
 
 void ecs_delete_entity(ecs_t* const self, entity_t const entity) {
     assert(self != nullptr);
-    assert(self->entities[entity] != nullptr);
-
-    entity_storage_t* const entity_storage = self->entities[entity];
+    assert(self->entities[entity]);
 
     for (ecs_component_t i = 0; i < NUM_ECS_COMPONENTS; i++) {
-        if (entity_storage->component_data[i] != nullptr) {
-            delete_component(i, entity_storage->component_data[i]);
+        if (is_in_pool(&(self->pools[i]), entity)) {
+            ecs_detach_component(self, entity, i);
         }
     }
 
-    free(entity_storage);
-    self->entities[entity] = nullptr;
-
-    OBJ_CTR_DEC(entity_storage_t);
+    self->entities[entity] = false;
 }
 
 void* const ecs_attach_component(ecs_t* const self, entity_t const entity, ecs_component_t const component) {
     assert(self != nullptr);
-    assert(self->entities[entity] != nullptr);
+    assert(self->entities[entity]);
     assert(component >= 0 && component < NUM_ECS_COMPONENTS);
-    assert(self->entities[entity]->component_data[component] == nullptr);
+    assert(!is_in_pool(&(self->pools[component]), entity));
 
     size_t const component_storage_size = COMPONENT_SIZES[component];
     assert(component_storage_size > 0);
 
-    entity_storage_t* const entity_storage = self->entities[entity];
+    component_pool_t* const pool = &(self->pools[component]);
+    assert(pool->size < MAX_ENTITIES);
 
-    void* const component_storage = new_component(component);
+    size_t const index = pool->size++;
+    pool->sparse[entity] = index;
+    pool->entities[index] = entity;
 
-    entity_storage->component_data[component] = component_storage;
+    void* const component_storage = &(pool->data[index * component_storage_size]);
+    init_component(component, component_storage);
 
     return component_storage;
 }
 
 void ecs_detach_component(ecs_t* const self, entity_t const entity, ecs_component_t const component) {
     assert(self != nullptr);
-    assert(self->entities[entity] != nullptr);
+    assert(self->entities[entity]);
     assert(component >= 0 && component < NUM_ECS_COMPONENTS);
-    assert(self->entities[entity]->component_data[component] != nullptr);
+    assert(is_in_pool(&(self->pools[component]), entity));
 
-    entity_storage_t* const entity_storage = self->entities[entity];
+    size_t const component_storage_size = COMPONENT_SIZES[component];
+    component_pool_t* const pool = &(self->pools[component]);
+
+    size_t const index = pool->sparse[entity];
+    clean_up_component(component, &(pool->data[index * component_storage_size]));
 
-    delete_component(component, entity_storage->component_data[component]);
-    entity_storage->component_data[component] = nullptr;
+    // Fill the hole with the last slot.
+    size_t const last = --pool->size;
+    if (index != last) {
+        memcpy(&(pool->data[index * component_storage_size]), &(pool->data[last * component_storage_size]), component_storage_size);
+        pool->entities[index] = pool->entities[last];
+        pool->sparse[pool->entities[index]] = index;
+    }
 }
 
 bool const ecs_has_component(ecs_t const* const self, entity_t const entity, ecs_component_t const component) {
     assert(self != nullptr);
-    assert(self->entities[entity] != nullptr);
+    assert(self->entities[entity]);
     assert(component >= 0 && component < NUM_ECS_COMPONENTS);
 
-    entity_storage_t* const entity_storage = self->entities[entity];
-
-    return entity_storage->component_data[component] != nullptr;
+    return is_in_pool(&(self->pools[component]), entity);
 }
 
 void* const ecs_get_component_data(ecs_t* const self, entity_t const entity, ecs_component_t const component) {
     assert(self != nullptr);
-    assert(self->entities[entity] != nullptr);
+    assert(self->entities[entity]);
     assert(component >= 0 && component < NUM_ECS_COMPONENTS);
-    assert(self->entities[entity]->component_data[component] != nullptr);
+    assert(is_in_pool(&(self->pools[component]), entity));
 
-    entity_storage_t* const entity_storage = self->entities[entity];
+    component_pool_t* const pool = &(self->pools[component]);
 
-    return entity_storage->component_data[component];
+    return &(pool->data[pool->sparse[entity] * COMPONENT_SIZES[component]]);
 }
 
 void ecs_attach_system(ecs_t* const self, ecs_component_t const component, ecs_system_t const system) {
@@ -250,15 +279,23 @@ bool const ecs_does_entity_exist(ecs_t* const self, entity_t const entity) {
         return false;
     }
 
-    return self->entities[entity] != nullptr;
+    return self->entities[entity];
 }
 
-static void* const new_component(ecs_component_t const component) {
-    assert(component >= 0 && component < NUM_ECS_COMPONENTS);
+static bool const is_in_pool(component_pool_t const* const pool, entity_t const entity) {
+    assert(pool != nullptr);
+
+    size_t const index = pool->sparse[entity];
 
-    void* const data = calloc(1, COMPONENT_SIZES[component]);
+    return index < pool->size && pool->entities[index] == entity;
+}
+
+static void init_component(ecs_component_t const component, void* const data) {
+    assert(component >= 0 && component < NUM_ECS_COMPONENTS);
     assert(data != nullptr);
 
+    memset(data, 0, COMPONENT_SIZES[component]);
+
     switch (component) {
         case ECS_COMPONENT__AABB: {
             ecs_component_aabb_t* c_data = data;
@@ -273,11 +310,9 @@ static void* const new_component(ecs_component_t const component) {
         default:
             // Do nothing
     }
-
-    return data;
 }
 
-static void delete_component(ecs_component_t const component, void* const data) {
+static void clean_up_component(ecs_component_t const component, void* const data) {
     assert(component >= 0 && component < NUM_ECS_COMPONENTS);
     assert(data != nullptr);
 
@@ -290,6 +325,4 @@ static void delete_component(ecs_component_t const component, void* const data)
         default:
             // Do nothing
     }
-
-    free(data);
-}
\ No newline at end of file
+}
@@ -15,6 +15,8 @@ ecs_t* const ecs_new(void);
 
 void ecs_delete(ecs_t* const self);
 
+// Runs each system over the entities holding its target component, in the order the components were attached.
+// Systems must not attach or detach their own target component meanwhile.
 void ecs_tick(ecs_t* const self, level_t* const level);
 
 entity_t const ecs_new_entity(ecs_t* const self);
@@ -27,6 +29,7 @@ void ecs_detach_component(ecs_t* const self, entity_t const entity, ecs_componen
 
 bool const ecs_has_component(ecs_t const* const self, entity_t const entity, ecs_component_t const component);
 
+// Component data stays put until a component of the same type is detached from any entity, including by deleting it.
 void* const ecs_get_component_data(ecs_t* const self, entity_t const entity, ecs_component_t const component);
 
 void ecs_attach_system(ecs_t* const self, ecs_component_t const component, ecs_system_t const system);
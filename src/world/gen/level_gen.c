@@ -1,196 +1,136 @@
 #include "./level_gen.h"
 
 #include <assert.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "src/util/object_counter.h"
 #include "src/world/gen/perlin.h"
+#include "src/world/gen/shape_table.h"
 #include "src/world/level.h"
 #include "src/util/logger.h"
+#include "src/util/util.h"
+
+#define SIGNED(coord) ((ptrdiff_t) (coord))
+#define HORIZONTAL_SIDES (SHAPE_MASK_SIDE(SIDE__NORTH) | SHAPE_MASK_SIDE(SIDE__SOUTH) | SHAPE_MASK_SIDE(SIDE__WEST) | SHAPE_MASK_SIDE(SIDE__EAST))
 
 struct level_gen {
     perlin_t* perlin;
 };
 
-typedef struct entry {
-    bool defined;
-    bool sides_present[NUM_SIDES];
-    bool has_extra;
-    struct {
-        bool north_west;
-        bool south_west;
-        bool north_east;
-        bool south_east;
-    } extra;
-} entry_t;
-
-static entry_t const SHAPE_LOOKUP[NUM_TILE_SHAPES] = {
-    [TILE_SHAPE__RAMP_NORTH] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = true,
-            [SIDE__SOUTH] = false,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = true,
-            [SIDE__EAST] = true
-        }
-    },
-    [TILE_SHAPE__RAMP_SOUTH] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = false,
-            [SIDE__SOUTH] = true,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = true,
-            [SIDE__EAST] = true
-        }
-    },
-    [TILE_SHAPE__RAMP_WEST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = true,
-            [SIDE__SOUTH] = true,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = true,
-            [SIDE__EAST] = false
-        }
-    },
-    [TILE_SHAPE__RAMP_EAST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = true,
-            [SIDE__SOUTH] = true,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = false,
-            [SIDE__EAST] = true
-        }
-    },
-    [TILE_SHAPE__CORNER_A_NORTH_WEST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = true,
-            [SIDE__SOUTH] = false,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = true,
-            [SIDE__EAST] = false
-        }
-    },
-    [TILE_SHAPE__CORNER_A_SOUTH_WEST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = false,
-            [SIDE__SOUTH] = true,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = true,
-            [SIDE__EAST] = false
-        }
-    },
-    [TILE_SHAPE__CORNER_A_NORTH_EAST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = true,
-            [SIDE__SOUTH] = false,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = false,
-            [SIDE__EAST] = true
-        }
-    },
-    [TILE_SHAPE__CORNER_A_SOUTH_EAST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = false,
-            [SIDE__SOUTH] = true,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = false,
-            [SIDE__EAST] = true
-        }
-    },
-    [TILE_SHAPE__CORNER_B_NORTH_WEST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = true,
-            [SIDE__SOUTH] = true,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = true,
-            [SIDE__EAST] = true
-        },
-        .has_extra = true,
-        .extra = {
-            .north_west = true,
-            .south_west = true,
-            .north_east = true,
-            .south_east = false
-        }
-    },
-    [TILE_SHAPE__CORNER_B_SOUTH_WEST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = true,
-            [SIDE__SOUTH] = true,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = true,
-            [SIDE__EAST] = true
-        },
-        .has_extra = true,
-        .extra = {
-            .north_west = true,
-            .south_west = true,
-            .north_east = false,
-            .south_east = true
-        }
-    },
-    [TILE_SHAPE__CORNER_B_NORTH_EAST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = true,
-            [SIDE__SOUTH] = true,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = true,
-            [SIDE__EAST] = true
-        },
-        .has_extra = true,
-        .extra = {
-            .north_west = true,
-            .south_west = false,
-            .north_east = true,
-            .south_east = true
-        }
-    },
-    [TILE_SHAPE__CORNER_B_SOUTH_EAST] = {
-        .defined = true,
-        .sides_present = {
-            [SIDE__NORTH] = true,
-            [SIDE__SOUTH] = true,
-            [SIDE__BOTTOM] = true,
-            [SIDE__TOP] = false,
-            [SIDE__WEST] = true,
-            [SIDE__EAST] = true
-        },
-        .has_extra = true,
-        .extra = {
-            .north_west = false,
-            .south_west = true,
-            .north_east = true,
-            .south_east = true
-        }
-    }
-};
-
-static void look_up_sides(level_t const* const level, size_chunks_t const level_size_tiles[NUM_AXES], size_t const pos[NUM_AXES], bool sides[NUM_SIDES]);
-
-static bool tile_matches_pattern(level_t const* const level, tile_shape_t const tile_shape, bool const sides[NUM_SIDES], size_t const pos[NUM_AXES]);
+/* SMOOTHING:
+ *     A tile column's smoothing reads the tiles one step around its surface
+ *     and only writes to itself. Visiting columns Z-major, it sees the rows
+ *     before it and the column before it in its own row already smoothed,
+ *     and everything else as generated. Instead of editing the level, each
+ *     column records its edits, and reads check the recorded edits of the
+ *     columns before it ahead of the chunks' occupancy masks, which stay
+ *     untouched meanwhile. Rows can then run on separate threads, as long
+ *     as each stays two columns behind the row before it. Finally the edits
+ *     are applied in the serial order, so the level ends up exactly as a
+ *     serial pass would leave it.
+ *
+ *     The shape of a surface tile only depends on which of its face and
+ *     diagonal neighbours are solid. SHAPE_TABLE is generated at build time
+ *     from the shape patterns in shape_table_gen.c and maps each of those
+ *     neighbour masks straight to the shapes that fit it.
+ */
+
+/* CAVES:
+ *     Caves are carved out wherever 3D noise passes CAVE_THRESHOLD. Rather
+ *     than sampling the noise at each of a chunk's 4096 tiles, it is sampled
+ *     on a lattice every CAVE_LATTICE_STEP tiles, 125 points a chunk, and
+ *     trilinearly interpolated in between. The outer points of the lattice
+ *     are shared with the neighbouring chunks and sampled at exactly the
+ *     same coordinates there, so caves carry on across chunk borders.
+ *
+ *     A crust CAVE_MIN_DEPTH tiles thick is left under the surface, so
+ *     smoothing always finds the solid ground it expects below the tiles it
+ *     shapes. Caves only open up where they run into the side of a cliff,
+ *     and smoothing shapes the overhang there from the carved tiles like any
+ *     other.
+ */
+
+#define CAVE_LATTICE_STEP 4
+#define CAVE_LATTICE_SIZE ((CHUNK_SIZE / CAVE_LATTICE_STEP) + 1)
+// In tiles. Powers of two, so that lattice points shared between chunks land on the same noise coordinates.
+#define CAVE_SCALE_XZ 32.0
+#define CAVE_SCALE_Y 16.0
+#define CAVE_THRESHOLD 0.4
+#define CAVE_MIN_DEPTH 4
+// Caves never reach below this Y.
+#define CAVE_FLOOR 4
+
+// The most edits smoothing makes to one column: clearing the surface, topping the tile below, shaping it, and the tile and shape under a corner.
+#define MAX_SMOOTH_EDITS 5
+
+typedef struct smooth_edit {
+    size_t y;
+    bool is_shape;
+    // A tile_t, or a tile_shape_t if is_shape is set.
+    uint8_t value;
+} smooth_edit_t;
+
+typedef struct smooth_column {
+    size_t num_edits;
+    smooth_edit_t edits[MAX_SMOOTH_EDITS];
+} smooth_column_t;
+
+typedef struct smooth_region {
+    pos_tiles_t min_x;
+    pos_tiles_t min_z;
+    size_t size_x;
+    size_t size_z;
+    // In tiles.
+    size_t height;
+    // Chunks from one tile before the region to one past it, indexed by Z, then X, then Y. nullptr outside a bounded level.
+    pos_chunks_t chunk_min_x;
+    pos_chunks_t chunk_min_z;
+    size_t num_chunks_x;
+    size_t num_chunks_z;
+    size_t num_chunks_y;
+    chunk_t const** chunks;
+    // These are indexed by Z then X within the region.
+    uint32_t* surface_heights;
+    smooth_column_t* columns;
+    // How many columns of each row are done.
+    atomic_size_t* progress;
+} smooth_region_t;
+
+// Fetches everything smoothing needs from the level for the columns from (min_x, min_z) up to but excluding (max_x, max_z).
+static void init_region(smooth_region_t* const region, level_t* const level, pos_tiles_t const min_x, pos_tiles_t const min_z, pos_tiles_t const max_x, pos_tiles_t const max_z);
+
+static void free_region(smooth_region_t* const region);
+
+static void smooth_row_task(void* const arg, size_t const index);
+
+static void smooth_column(smooth_region_t* const region, size_t const index);
+
+static void add_edit(smooth_column_t* const column, size_t const y, bool const is_shape, uint8_t const value);
+
+static bool is_solid(smooth_region_t const* const region, size_t const index, pos_tiles_t const pos[NUM_AXES]);
+
+// Face neighbours of the tile at pos, as bits of a neighbour mask.
+static unsigned const look_up_sides(smooth_region_t const* const region, size_t const index, pos_tiles_t const pos[NUM_AXES]);
+
+static unsigned const look_up_diagonals(smooth_region_t const* const region, size_t const index, pos_tiles_t const pos[NUM_AXES]);
+
+// Shape for a surface tile with the given neighbour mask, or TILE_SHAPE__FLAT if none fits.
+static tile_shape_t const pick_shape(unsigned const mask);
+
+// Shape for the tile under a surface tile shaped as an inner corner, or TILE_SHAPE__FLAT if it keeps none.
+static tile_shape_t const pick_shape_below_corner(smooth_region_t const* const region, size_t const index, tile_shape_t const corner, pos_tiles_t const pos[NUM_AXES]);
+
+static bool const is_inner_corner(tile_shape_t const shape);
+
+static void fill_noise_grid(level_gen_t const* const self, ptrdiff_t const origin_x, ptrdiff_t const origin_z, double const scale, double grid[CHUNK_SIZE * CHUNK_SIZE]);
+
+// Samples the cave lattice of the chunk, indexed by Z, then Y, then X. Returns false without sampling if the chunk cannot hold caves.
+static bool const sample_caves(level_gen_t const* const self, level_gen_column_t const* const column, pos_chunks_t const chunk_pos[NUM_AXES], double lattice[CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE]);
+
+// Interpolates the lattice across X and Z to the tile column at (x, z), leaving its CAVE_LATTICE_SIZE points along Y.
+static void interpolate_caves(double const lattice[CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE], size_t const x, size_t const z, double densities[CAVE_LATTICE_SIZE]);
 
 level_gen_t* const level_gen_new(uint64_t const seed) {
     level_gen_t* const self = malloc(sizeof(level_gen_t));
@@ -213,184 +153,450 @@ void level_gen_delete(level_gen_t* const self) {
     OBJ_CTR_DEC(level_gen_t);
 }
 
-void level_gen_generate(level_gen_t* const self, chunk_t* const chunk) {
+void level_gen_shape_column(level_gen_t const* const self, pos_chunks_t const chunk_x, pos_chunks_t const chunk_z, level_gen_column_t* const column) {
     assert(self != nullptr);
-    assert(chunk != nullptr);
+    assert(column != nullptr);
 
-    size_chunks_t chunk_pos[NUM_AXES];
-    chunk_get_pos(chunk, chunk_pos);
+    pos_tiles_t const origin_x = (pos_tiles_t) chunk_x * CHUNK_SIZE;
+    pos_tiles_t const origin_z = (pos_tiles_t) chunk_z * CHUNK_SIZE;
 
     double grid[CHUNK_SIZE * CHUNK_SIZE];
-    float scale = 64.0f;
-    for (size_t x = 0; x < CHUNK_SIZE; x++) {
-        for (size_t z = 0; z < CHUNK_SIZE; z++) {
-            grid[z * CHUNK_SIZE + x] = perlin_get_2d(self->perlin, (chunk_pos[AXIS__X] * CHUNK_SIZE + x) / scale, (chunk_pos[AXIS__Z] * CHUNK_SIZE + z) / scale);
-        }
-    }
+    fill_noise_grid(self, origin_x, origin_z, 64.0, grid);
     double grid2[CHUNK_SIZE * CHUNK_SIZE];
-    scale = 16.0f;
-    for (size_t x = 0; x < CHUNK_SIZE; x++) {
-        for (size_t z = 0; z < CHUNK_SIZE; z++) {
-            grid2[z * CHUNK_SIZE + x] = perlin_get_2d(self->perlin, (chunk_pos[AXIS__X] * CHUNK_SIZE + x) / scale, (chunk_pos[AXIS__Z] * CHUNK_SIZE + z) / scale);
-        }
-    }
+    fill_noise_grid(self, origin_x, origin_z, 16.0, grid2);
     double grid3[CHUNK_SIZE * CHUNK_SIZE];
-    scale = 32.0f;
-    for (size_t x = 0; x < CHUNK_SIZE; x++) {
-        for (size_t z = 0; z < CHUNK_SIZE; z++) {
-            grid3[z * CHUNK_SIZE + x] = perlin_get_2d(self->perlin, (chunk_pos[AXIS__X] * CHUNK_SIZE + x) / scale, (chunk_pos[AXIS__Z] * CHUNK_SIZE + z) / scale);
+    fill_noise_grid(self, origin_x, origin_z, 32.0, grid3);
+
+    for (size_t i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+        double hd = grid[i];
+        hd += grid2[i] * 0.25f;
+        if (grid3[i] > 0.4f) {
+            hd -= grid3[i];
         }
+        int yo = 16 - (int)(hd * 16);
+        size_t height = 64 + yo;
+        column->heights[i] = height;
+        column->surface_tiles[i] = height <= 75 ? TILE__SAND : TILE__GRASS;
+    }
+}
+
+void level_gen_generate(level_gen_t const* const self, level_gen_column_t const* const column, chunk_t* const chunk, uint64_t* const noise_ns) {
+    assert(self != nullptr);
+    assert(column != nullptr);
+    assert(chunk != nullptr);
+
+    pos_chunks_t chunk_pos[NUM_AXES];
+    chunk_get_pos(chunk, chunk_pos);
+    size_t const origin_y = (size_t) chunk_pos[AXIS__Y] * CHUNK_SIZE;
+
+    uint64_t const start_time = noise_ns != nullptr ? get_time_ns() : 0;
+    double lattice[CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE];
+    bool const has_caves = sample_caves(self, column, chunk_pos, lattice);
+    if (noise_ns != nullptr) {
+        *noise_ns += get_time_ns() - start_time;
     }
 
     for (size_t x = 0; x < CHUNK_SIZE; x++) {
         for (size_t z = 0; z < CHUNK_SIZE; z++) {
-            size_t wx = chunk_pos[AXIS__X] * CHUNK_SIZE + x;
-            size_t wz = chunk_pos[AXIS__Z] * CHUNK_SIZE + z;
-
-            double hd = grid[z * CHUNK_SIZE + x];
-            hd += grid2[z * CHUNK_SIZE + x] * 0.25f;
-            if (grid3[z * CHUNK_SIZE + x] > 0.4f) {
-                hd -= grid3[z * CHUNK_SIZE + x];
+            size_t const height = column->heights[z * CHUNK_SIZE + x];
+            double densities[CAVE_LATTICE_SIZE];
+            if (has_caves) {
+                interpolate_caves(lattice, x, z, densities);
             }
-            int yo = 16 - (int)(hd * 16);
-            size_t height = 64 + yo;
-            for (size_t y = 0; y < CHUNK_SIZE && (chunk_pos[AXIS__Y] * CHUNK_SIZE + y) < height; y++) {
-                size_t wy = chunk_pos[AXIS__Y] * CHUNK_SIZE + y;
+            for (size_t y = 0; y < CHUNK_SIZE && (origin_y + y) < height; y++) {
+                if (has_caves && origin_y + y >= CAVE_FLOOR && origin_y + y + CAVE_MIN_DEPTH < height) {
+                    size_t const cell = y / CAVE_LATTICE_STEP;
+                    double const t = (double) (y % CAVE_LATTICE_STEP) / CAVE_LATTICE_STEP;
+                    if (densities[cell] + (t * (densities[cell + 1] - densities[cell])) > CAVE_THRESHOLD) {
+                        continue;
+                    }
+                }
                 chunk_set_tile(chunk, (size_t[NUM_AXES]) { x, y, z }, TILE__STONE);
             }
-            if (height >= chunk_pos[AXIS__Y] * CHUNK_SIZE && height < chunk_pos[AXIS__Y] * CHUNK_SIZE + CHUNK_SIZE) {
-                tile_t top_tile = TILE__GRASS;
-                if (height <= 75) {
-                    top_tile = TILE__SAND;
-                }
-                chunk_set_tile(chunk, (size_t[NUM_AXES]) { x, height - (chunk_pos[AXIS__Y] * CHUNK_SIZE), z }, top_tile);
+            if (height >= origin_y && height < origin_y + CHUNK_SIZE) {
+                chunk_set_tile(chunk, (size_t[NUM_AXES]) { x, height - origin_y, z }, column->surface_tiles[z * CHUNK_SIZE + x]);
             }
         }
     }
 }
 
-void level_gen_smooth(level_gen_t const* const self, level_t* const level) {
+void level_gen_smooth(level_gen_t const* const self, level_t* const level, thread_pool_t* const pool) {
     assert(self != nullptr);
     assert(level != nullptr);
 
     size_chunks_t level_size[NUM_AXES];
     level_get_size(level, level_size);
-    size_t level_size_tiles[NUM_AXES];
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        level_size_tiles[a] = level_size[a] * CHUNK_SIZE;
-    }
 
     LOG_DEBUG("level_gen_t: smoothing %zu chunks...", level_size[AXIS__X] * level_size[AXIS__Y] * level_size[AXIS__Z]);
 
-    for (size_t z = 0; z < level_size_tiles[AXIS__Z]; z++) {
-        for (size_t x = 0; x < level_size_tiles[AXIS__X]; x++) {
-            size_t pos[NUM_AXES] = { x, level_size_tiles[AXIS__Y] - 1, z };
+    level_gen_smooth_region(self, level, pool, 0, 0, (pos_tiles_t) (level_size[AXIS__X] * CHUNK_SIZE), (pos_tiles_t) (level_size[AXIS__Z] * CHUNK_SIZE));
+}
+
+void level_gen_smooth_region(level_gen_t const* const self, level_t* const level, thread_pool_t* const pool, pos_tiles_t const min_x, pos_tiles_t const min_z, pos_tiles_t const max_x, pos_tiles_t const max_z) {
+    assert(self != nullptr);
+    assert(level != nullptr);
+    assert(max_x >= min_x && max_z >= min_z);
+
+    if (max_x == min_x || max_z == min_z) {
+        return;
+    }
+
+    smooth_region_t region;
+    init_region(&region, level, min_x, min_z, max_x, max_z);
 
-            tile_t tile;
-            while ((tile = level_get_tile(level, pos)) == TILE__AIR) {
-                pos[AXIS__Y]--;
+    if (pool != nullptr) {
+        thread_pool_run(pool, region.size_z, smooth_row_task, &region);
+    } else {
+        for (size_t rz = 0; rz < region.size_z; rz++) {
+            smooth_row_task(&region, rz);
+        }
+    }
+
+    // Applying the edits in the serial order keeps the journal and chunk generations the same too.
+    for (size_t rz = 0; rz < region.size_z; rz++) {
+        for (size_t rx = 0; rx < region.size_x; rx++) {
+            smooth_column_t const* const column = &(region.columns[(rz * region.size_x) + rx]);
+            for (size_t i = 0; i < column->num_edits; i++) {
+                smooth_edit_t const* const edit = &(column->edits[i]);
+                pos_tiles_t const pos[NUM_AXES] = { min_x + SIGNED(rx), SIGNED(edit->y), min_z + SIGNED(rz) };
+                if (edit->is_shape) {
+                    level_set_tile_shape(level, pos, (tile_shape_t) edit->value);
+                } else {
+                    level_set_tile(level, pos, (tile_t) edit->value);
+                }
             }
+        }
+    }
 
-            bool sides_present[NUM_SIDES];
-            look_up_sides(level, level_size_tiles, pos, sides_present);
+    free_region(&region);
+}
 
-            if (sides_present[SIDE__NORTH] + sides_present[SIDE__SOUTH] + sides_present[SIDE__WEST] + sides_present[SIDE__EAST] < 2) {
-                level_set_tile(level, pos, TILE__AIR);
-                pos[AXIS__Y]--;
-                tile_t top_tile = TILE__GRASS;
-                if (pos[AXIS__Y] <= 75) {
-                    top_tile = TILE__SAND;
+void level_gen_reshape_around(level_gen_t const* const self, level_t* const level, pos_tiles_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+    assert(level != nullptr);
+    assert(!level_is_tile_oob(level, pos));
+
+    smooth_region_t region;
+    init_region(&region, level, pos[AXIS__X] - 1, pos[AXIS__Z] - 1, pos[AXIS__X] + 2, pos[AXIS__Z] + 2);
+
+    // A tile's shape depends on the tiles one step around it, and on whether it is on the surface or right under a corner,
+    // which an edit can only change from two tiles below it to one above.
+    pos_tiles_t const min_y = pos[AXIS__Y] - 2 > 0 ? pos[AXIS__Y] - 2 : 0;
+    pos_tiles_t const max_y = pos[AXIS__Y] + 2 < SIGNED(region.height) ? pos[AXIS__Y] + 2 : SIGNED(region.height);
+
+    for (size_t index = 0; index < region.size_x * region.size_z; index++) {
+        pos_tiles_t const x = region.min_x + SIGNED(index % region.size_x);
+        pos_tiles_t const z = region.min_z + SIGNED(index / region.size_x);
+        if (level_is_tile_oob(level, (pos_tiles_t[NUM_AXES]) { x, 0, z })) {
+            continue;
+        }
+
+        pos_tiles_t const height = SIGNED(region.surface_heights[index]);
+        for (pos_tiles_t y = min_y; y < max_y; y++) {
+            pos_tiles_t const tile_pos[NUM_AXES] = { x, y, z };
+            if (!is_solid(&region, index, tile_pos)) {
+                continue;
+            }
+
+            tile_shape_t shape = TILE_SHAPE__FLAT;
+            if (y + 1 == height) {
+                shape = pick_shape(look_up_sides(&region, index, tile_pos) | look_up_diagonals(&region, index, tile_pos));
+            } else if (y + 2 == height) {
+                pos_tiles_t const surface_pos[NUM_AXES] = { x, y + 1, z };
+                tile_shape_t const surface_shape = pick_shape(look_up_sides(&region, index, surface_pos) | look_up_diagonals(&region, index, surface_pos));
+                if (is_inner_corner(surface_shape)) {
+                    shape = pick_shape_below_corner(&region, index, surface_shape, tile_pos);
                 }
-                level_set_tile(level, pos, top_tile);
             }
 
-            size_t const pos_below[NUM_AXES] = { pos[AXIS__X], pos[AXIS__Y] - 1, pos[AXIS__Z] };
-
-            for (tile_shape_t i = 0; i < NUM_TILE_SHAPES; i++) {
-                if (SHAPE_LOOKUP[i].defined) {
-                    if (tile_matches_pattern(level, i, sides_present, pos)) {
-                        level_set_tile_shape(level, pos, i);
-                        if (i == TILE_SHAPE__CORNER_A_NORTH_WEST || i == TILE_SHAPE__CORNER_A_SOUTH_WEST || i == TILE_SHAPE__CORNER_A_NORTH_EAST || i == TILE_SHAPE__CORNER_A_SOUTH_EAST) {
-                            tile_t top_tile = TILE__GRASS;
-                            if (pos[AXIS__Y] - 1 <= 75) {
-                                top_tile = TILE__SAND;
-                            }
-                            level_set_tile(level, pos_below, top_tile);
-
-                            tile_shape_t below_shape_candidate = i + 4;
-                            if (SHAPE_LOOKUP[below_shape_candidate].defined) {
-                                bool below_sides_present[NUM_SIDES];
-                                look_up_sides(level, level_size_tiles, pos_below, below_sides_present);
-                                below_sides_present[SIDE__TOP] = false;
-                                if (tile_matches_pattern(level, below_shape_candidate, below_sides_present, pos_below) ||
-                                    (!below_sides_present[SIDE__NORTH] || !below_sides_present[SIDE__SOUTH] || !below_sides_present[SIDE__WEST] || !below_sides_present[SIDE__EAST])
-                                ) {
-                                    level_set_tile_shape(level, pos_below, below_shape_candidate);
-                                }
-                            }
-                        }
-
-                        break;
+            // Leaves untouched chunks alone.
+            if (level_get_tile_shape(level, tile_pos) != shape) {
+                level_set_tile_shape(level, tile_pos, shape);
+            }
+        }
+    }
+
+    free_region(&region);
+}
+
+static void init_region(smooth_region_t* const region, level_t* const level, pos_tiles_t const min_x, pos_tiles_t const min_z, pos_tiles_t const max_x, pos_tiles_t const max_z) {
+    assert(region != nullptr);
+    assert(level != nullptr);
+
+    size_chunks_t level_size[NUM_AXES];
+    level_get_size(level, level_size);
+
+    *region = (smooth_region_t) {
+        .min_x = min_x,
+        .min_z = min_z,
+        .size_x = (size_t) (max_x - min_x),
+        .size_z = (size_t) (max_z - min_z),
+        .height = level_size[AXIS__Y] * CHUNK_SIZE,
+        .chunk_min_x = (pos_chunks_t) CHUNK_COORD(min_x - 1),
+        .chunk_min_z = (pos_chunks_t) CHUNK_COORD(min_z - 1),
+        .num_chunks_y = level_size[AXIS__Y]
+    };
+    region->num_chunks_x = (size_t) (CHUNK_COORD(max_x) - region->chunk_min_x + 1);
+    region->num_chunks_z = (size_t) (CHUNK_COORD(max_z) - region->chunk_min_z + 1);
+
+    size_t const num_columns = region->size_x * region->size_z;
+    region->chunks = malloc(sizeof(chunk_t const*) * region->num_chunks_x * region->num_chunks_z * region->num_chunks_y);
+    region->surface_heights = calloc(num_columns, sizeof(uint32_t));
+    region->columns = calloc(num_columns, sizeof(smooth_column_t));
+    region->progress = malloc(sizeof(atomic_size_t) * region->size_z);
+    assert(region->chunks != nullptr && region->surface_heights != nullptr && region->columns != nullptr && region->progress != nullptr);
+
+    // Everything that goes through the level happens here, on the calling thread.
+    for (size_t cz = 0; cz < region->num_chunks_z; cz++) {
+        for (size_t cx = 0; cx < region->num_chunks_x; cx++) {
+            pos_chunks_t const chunk_x = region->chunk_min_x + (pos_chunks_t) cx;
+            pos_chunks_t const chunk_z = region->chunk_min_z + (pos_chunks_t) cz;
+            bool const oob = level_is_tile_oob(level, (pos_tiles_t[NUM_AXES]) { (pos_tiles_t) chunk_x * CHUNK_SIZE, 0, (pos_tiles_t) chunk_z * CHUNK_SIZE });
+            for (size_t cy = 0; cy < region->num_chunks_y; cy++) {
+                region->chunks[((cz * region->num_chunks_x) + cx) * region->num_chunks_y + cy] = oob ? nullptr : level_get_chunk(level, (pos_chunks_t[NUM_AXES]) { chunk_x, (pos_chunks_t) cy, chunk_z });
+            }
+        }
+    }
+
+    // Columns outside a bounded level are left at 0.
+    for (size_t cz = 0; cz < region->num_chunks_z; cz++) {
+        for (size_t cx = 0; cx < region->num_chunks_x; cx++) {
+            pos_chunks_t const chunk_x = region->chunk_min_x + (pos_chunks_t) cx;
+            pos_chunks_t const chunk_z = region->chunk_min_z + (pos_chunks_t) cz;
+            bool const overlaps = (pos_tiles_t) chunk_x * CHUNK_SIZE < max_x && ((pos_tiles_t) chunk_x + 1) * CHUNK_SIZE > min_x &&
+                (pos_tiles_t) chunk_z * CHUNK_SIZE < max_z && ((pos_tiles_t) chunk_z + 1) * CHUNK_SIZE > min_z;
+            if (!overlaps || region->chunks[((cz * region->num_chunks_x) + cx) * region->num_chunks_y] == nullptr) {
+                continue;
+            }
+
+            uint32_t heights[CHUNK_SIZE * CHUNK_SIZE];
+            level_get_surface_heights(level, chunk_x, chunk_z, heights);
+            for (size_t lz = 0; lz < CHUNK_SIZE; lz++) {
+                for (size_t lx = 0; lx < CHUNK_SIZE; lx++) {
+                    pos_tiles_t const rx = ((pos_tiles_t) chunk_x * CHUNK_SIZE) + SIGNED(lx) - min_x;
+                    pos_tiles_t const rz = ((pos_tiles_t) chunk_z * CHUNK_SIZE) + SIGNED(lz) - min_z;
+                    if (rx >= 0 && rx < SIGNED(region->size_x) && rz >= 0 && rz < SIGNED(region->size_z)) {
+                        region->surface_heights[((size_t) rz * region->size_x) + (size_t) rx] = heights[(lz * CHUNK_SIZE) + lx];
                     }
                 }
             }
         }
     }
+
+    for (size_t rz = 0; rz < region->size_z; rz++) {
+        atomic_init(&(region->progress[rz]), 0);
+    }
 }
 
-static void look_up_sides(level_t const* const level, size_chunks_t const level_size_tiles[NUM_AXES], size_t const pos[NUM_AXES], bool sides[NUM_SIDES]) {
-    assert(level != nullptr);
+static void free_region(smooth_region_t* const region) {
+    assert(region != nullptr);
 
-    for (side_t i = 0; i < NUM_SIDES; i++) {
-        int offsets[NUM_AXES];
-        side_get_offsets(i, offsets);
-        int pos_t[NUM_AXES] = { pos[AXIS__X] + offsets[AXIS__X], pos[AXIS__Y] + offsets[AXIS__Y], pos[AXIS__Z] + offsets[AXIS__Z] };
+    free(region->progress);
+    free(region->columns);
+    free(region->surface_heights);
+    free(region->chunks);
+}
+
+static void smooth_row_task(void* const arg, size_t const index) {
+    assert(arg != nullptr);
 
-        sides[i] = false;
+    smooth_region_t* const region = arg;
 
-        for (axis_t a = 0; a < NUM_AXES; a++) {
-            if (pos_t[a] < 0 || pos_t[a] >= level_size_tiles[a]) {
-                sides[i] = true;
-                break;
+    for (size_t rx = 0; rx < region->size_x; rx++) {
+        if (index > 0) {
+            // A column reads the previous row up to one tile east of itself, which has to be done by now.
+            size_t const needed = (rx + 2 < region->size_x) ? rx + 2 : region->size_x;
+            while (atomic_load_explicit(&(region->progress[index - 1]), memory_order_acquire) < needed) {
+                sched_yield();
             }
         }
-        if (!sides[i]) {
-            size_t const pos_t_u[NUM_AXES] = { pos_t[AXIS__X], pos_t[AXIS__Y], pos_t[AXIS__Z] };
-            tile_t const offset_tile = level_get_tile(level, pos_t_u);
-            sides[i] = offset_tile != TILE__AIR;
+
+        smooth_column(region, (index * region->size_x) + rx);
+        atomic_store_explicit(&(region->progress[index]), rx + 1, memory_order_release);
+    }
+}
+
+static void smooth_column(smooth_region_t* const region, size_t const index) {
+    assert(region != nullptr);
+
+    smooth_column_t* const column = &(region->columns[index]);
+    column->num_edits = 0;
+
+    size_t const height = region->surface_heights[index];
+    assert(height > 0);
+    pos_tiles_t pos[NUM_AXES] = { region->min_x + SIGNED(index % region->size_x), SIGNED(height) - 1, region->min_z + SIGNED(index / region->size_x) };
+
+    unsigned const sides = look_up_sides(region, index, pos);
+
+    if (__builtin_popcount(sides & HORIZONTAL_SIDES) < 2) {
+        add_edit(column, (size_t) pos[AXIS__Y], false, TILE__AIR);
+        pos[AXIS__Y]--;
+        tile_t top_tile = TILE__GRASS;
+        if (pos[AXIS__Y] <= 75) {
+            top_tile = TILE__SAND;
+        }
+        add_edit(column, (size_t) pos[AXIS__Y], false, top_tile);
+    }
+
+    pos_tiles_t const pos_below[NUM_AXES] = { pos[AXIS__X], pos[AXIS__Y] - 1, pos[AXIS__Z] };
+
+    // The sides still come from before any lowering, but the diagonals are read at the new surface.
+    tile_shape_t const shape = pick_shape(sides | look_up_diagonals(region, index, pos));
+    if (shape == TILE_SHAPE__FLAT) {
+        return;
+    }
+
+    add_edit(column, (size_t) pos[AXIS__Y], true, shape);
+    if (is_inner_corner(shape)) {
+        tile_t top_tile = TILE__GRASS;
+        if (pos[AXIS__Y] - 1 <= 75) {
+            top_tile = TILE__SAND;
+        }
+        add_edit(column, (size_t) pos_below[AXIS__Y], false, top_tile);
+
+        tile_shape_t const below_shape = pick_shape_below_corner(region, index, shape, pos_below);
+        if (below_shape != TILE_SHAPE__FLAT) {
+            add_edit(column, (size_t) pos_below[AXIS__Y], true, below_shape);
         }
     }
 }
 
-static bool tile_matches_pattern(level_t const* const level, tile_shape_t const tile_shape, bool const sides[NUM_SIDES], size_t const pos[NUM_AXES]) {
-    assert(level != nullptr);
-    assert(tile_shape >= 0 && tile_shape < NUM_TILE_SHAPES);
-
-    if (memcmp(sides, SHAPE_LOOKUP[tile_shape].sides_present, sizeof(bool) * NUM_SIDES) == 0) {
-        if (SHAPE_LOOKUP[tile_shape].has_extra) {
-            size_t const pos_north_west[NUM_AXES] = { pos[AXIS__X] - 1, pos[AXIS__Y], pos[AXIS__Z] - 1 };
-            size_t const pos_south_west[NUM_AXES] = { pos[AXIS__X] + 1, pos[AXIS__Y], pos[AXIS__Z] - 1 };
-            size_t const pos_north_east[NUM_AXES] = { pos[AXIS__X] - 1, pos[AXIS__Y], pos[AXIS__Z] + 1 };
-            size_t const pos_south_east[NUM_AXES] = { pos[AXIS__X] + 1, pos[AXIS__Y], pos[AXIS__Z] + 1 };
-
-            struct {
-                bool north_west;
-                bool south_west;
-                bool north_east;
-                bool south_east;
-            } extra = {
-                .north_west = !level_is_tile_oob(level, pos_north_west) ? level_get_tile(level, pos_north_west) != TILE__AIR : true,
-                .south_west = !level_is_tile_oob(level, pos_south_west) ? level_get_tile(level, pos_south_west) != TILE__AIR : true,
-                .north_east = !level_is_tile_oob(level, pos_north_east) ? level_get_tile(level, pos_north_east) != TILE__AIR : true,
-                .south_east = !level_is_tile_oob(level, pos_south_east) ? level_get_tile(level, pos_south_east) != TILE__AIR : true
-            };
-            if (memcmp(&extra, &(SHAPE_LOOKUP[tile_shape].extra), sizeof(extra)) != 0) {
-                return false;
+static void add_edit(smooth_column_t* const column, size_t const y, bool const is_shape, uint8_t const value) {
+    assert(column != nullptr);
+    assert(column->num_edits < MAX_SMOOTH_EDITS);
+
+    column->edits[column->num_edits++] = (smooth_edit_t) { .y = y, .is_shape = is_shape, .value = value };
+}
+
+static bool is_solid(smooth_region_t const* const region, size_t const index, pos_tiles_t const pos[NUM_AXES]) {
+    assert(region != nullptr);
+
+    // Columns up to this one in the serial order have been smoothed, so their edits count. Later ones still read as they were.
+    pos_tiles_t const rx = pos[AXIS__X] - region->min_x;
+    pos_tiles_t const rz = pos[AXIS__Z] - region->min_z;
+    if (rx >= 0 && rx < SIGNED(region->size_x) && rz >= 0 && rz < SIGNED(region->size_z) && ((size_t) rz * region->size_x) + (size_t) rx <= index) {
+        smooth_column_t const* const column = &(region->columns[((size_t) rz * region->size_x) + (size_t) rx]);
+        for (size_t i = column->num_edits; i > 0; i--) {
+            smooth_edit_t const* const edit = &(column->edits[i - 1]);
+            if (!edit->is_shape && SIGNED(edit->y) == pos[AXIS__Y]) {
+                return edit->value != TILE__AIR;
             }
         }
+    }
 
+    if (pos[AXIS__Y] < 0 || pos[AXIS__Y] >= SIGNED(region->height)) {
         return true;
     }
 
-    return false;
+    size_t const cx = (size_t) (CHUNK_COORD(pos[AXIS__X]) - region->chunk_min_x);
+    size_t const cz = (size_t) (CHUNK_COORD(pos[AXIS__Z]) - region->chunk_min_z);
+    assert(cx < region->num_chunks_x && cz < region->num_chunks_z);
+    chunk_t const* const chunk = region->chunks[((cz * region->num_chunks_x) + cx) * region->num_chunks_y + ((size_t) pos[AXIS__Y] / CHUNK_SIZE)];
+    if (chunk == nullptr) {
+        return true;
+    }
+
+    chunk_row_t const row = chunk_get_occupancy(chunk)[CHUNK_ROW(CHUNK_LOCAL(pos[AXIS__Y]), CHUNK_LOCAL(pos[AXIS__Z]))];
+    return (row >> CHUNK_LOCAL(pos[AXIS__X])) & 1;
+}
+
+static unsigned const look_up_sides(smooth_region_t const* const region, size_t const index, pos_tiles_t const pos[NUM_AXES]) {
+    assert(region != nullptr);
+
+    unsigned sides = 0;
+    for (side_t i = 0; i < NUM_SIDES; i++) {
+        int offsets[NUM_AXES];
+        side_get_offsets(i, offsets);
+
+        if (is_solid(region, index, (pos_tiles_t[NUM_AXES]) { pos[AXIS__X] + offsets[AXIS__X], pos[AXIS__Y] + offsets[AXIS__Y], pos[AXIS__Z] + offsets[AXIS__Z] })) {
+            sides |= SHAPE_MASK_SIDE(i);
+        }
+    }
+
+    return sides;
+}
+
+static unsigned const look_up_diagonals(smooth_region_t const* const region, size_t const index, pos_tiles_t const pos[NUM_AXES]) {
+    assert(region != nullptr);
+
+    pos_tiles_t const x = pos[AXIS__X];
+    pos_tiles_t const y = pos[AXIS__Y];
+    pos_tiles_t const z = pos[AXIS__Z];
+
+    return (is_solid(region, index, (pos_tiles_t[NUM_AXES]) { x - 1, y, z - 1 }) ? SHAPE_MASK_NORTH_WEST : 0) |
+        (is_solid(region, index, (pos_tiles_t[NUM_AXES]) { x + 1, y, z - 1 }) ? SHAPE_MASK_SOUTH_WEST : 0) |
+        (is_solid(region, index, (pos_tiles_t[NUM_AXES]) { x - 1, y, z + 1 }) ? SHAPE_MASK_NORTH_EAST : 0) |
+        (is_solid(region, index, (pos_tiles_t[NUM_AXES]) { x + 1, y, z + 1 }) ? SHAPE_MASK_SOUTH_EAST : 0);
+}
+
+static tile_shape_t const pick_shape(unsigned const mask) {
+    unsigned const shapes = SHAPE_TABLE[mask];
+
+    // The first fitting shape wins.
+    return shapes != 0 ? (tile_shape_t) __builtin_ctz(shapes) : TILE_SHAPE__FLAT;
+}
+
+static tile_shape_t const pick_shape_below_corner(smooth_region_t const* const region, size_t const index, tile_shape_t const corner, pos_tiles_t const pos[NUM_AXES]) {
+    assert(region != nullptr);
+    assert(is_inner_corner(corner));
+
+    // Each inner corner has a matching outer corner four shapes on.
+    tile_shape_t const candidate = corner + 4;
+    if ((DEFINED_SHAPES & (1u << candidate)) == 0) {
+        return TILE_SHAPE__FLAT;
+    }
+
+    unsigned const sides = look_up_sides(region, index, pos) & ~SHAPE_MASK_SIDE(SIDE__TOP);
+    if ((SHAPE_TABLE[sides | look_up_diagonals(region, index, pos)] & (1u << candidate)) != 0 || (sides & HORIZONTAL_SIDES) != HORIZONTAL_SIDES) {
+        return candidate;
+    }
+
+    return TILE_SHAPE__FLAT;
+}
+
+static bool const is_inner_corner(tile_shape_t const shape) {
+    return shape == TILE_SHAPE__CORNER_A_NORTH_WEST || shape == TILE_SHAPE__CORNER_A_SOUTH_WEST || shape == TILE_SHAPE__CORNER_A_NORTH_EAST || shape == TILE_SHAPE__CORNER_A_SOUTH_EAST;
+}
+
+// Samples 2D noise at every tile of a chunk column, indexed by local Z then X. Scales are powers of two, so the points land exactly where per-tile division would put them.
+static void fill_noise_grid(level_gen_t const* const self, ptrdiff_t const origin_x, ptrdiff_t const origin_z, double const scale, double grid[CHUNK_SIZE * CHUNK_SIZE]) {
+    perlin_fill_grid_2d(self->perlin, (double[2]) { origin_x / scale, origin_z / scale }, (double[2]) { 1.0 / scale, 1.0 / scale }, (size_t[2]) { CHUNK_SIZE, CHUNK_SIZE }, grid);
+}
+
+static bool const sample_caves(level_gen_t const* const self, level_gen_column_t const* const column, pos_chunks_t const chunk_pos[NUM_AXES], double lattice[CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE]) {
+    assert(self != nullptr);
+    assert(column != nullptr);
+
+    size_t max_height = 0;
+    for (size_t i = 0; i < CHUNK_SIZE * CHUNK_SIZE; i++) {
+        if (column->heights[i] > max_height) {
+            max_height = column->heights[i];
+        }
+    }
+
+    size_t const origin_y = (size_t) chunk_pos[AXIS__Y] * CHUNK_SIZE;
+    if (origin_y + CHUNK_SIZE <= CAVE_FLOOR || origin_y + CAVE_MIN_DEPTH >= max_height) {
+        return false;
+    }
+
+    double const origin[3] = { (double) ((pos_tiles_t) chunk_pos[AXIS__X] * CHUNK_SIZE) / CAVE_SCALE_XZ, (double) origin_y / CAVE_SCALE_Y, (double) ((pos_tiles_t) chunk_pos[AXIS__Z] * CHUNK_SIZE) / CAVE_SCALE_XZ };
+    double const step[3] = { CAVE_LATTICE_STEP / CAVE_SCALE_XZ, CAVE_LATTICE_STEP / CAVE_SCALE_Y, CAVE_LATTICE_STEP / CAVE_SCALE_XZ };
+    perlin_fill_grid_3d(self->perlin, origin, step, (size_t[3]) { CAVE_LATTICE_SIZE, CAVE_LATTICE_SIZE, CAVE_LATTICE_SIZE }, lattice);
+
+    return true;
+}
+
+static void interpolate_caves(double const lattice[CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE * CAVE_LATTICE_SIZE], size_t const x, size_t const z, double densities[CAVE_LATTICE_SIZE]) {
+    size_t const cell_x = x / CAVE_LATTICE_STEP;
+    size_t const cell_z = z / CAVE_LATTICE_STEP;
+    double const tx = (double) (x % CAVE_LATTICE_STEP) / CAVE_LATTICE_STEP;
+    double const tz = (double) (z % CAVE_LATTICE_STEP) / CAVE_LATTICE_STEP;
+
+    for (size_t j = 0; j < CAVE_LATTICE_SIZE; j++) {
+        double const* const near_row = &(lattice[((cell_z * CAVE_LATTICE_SIZE) + j) * CAVE_LATTICE_SIZE]);
+        double const* const far_row = &(lattice[(((cell_z + 1) * CAVE_LATTICE_SIZE) + j) * CAVE_LATTICE_SIZE]);
+        double const near = near_row[cell_x] + (tx * (near_row[cell_x + 1] - near_row[cell_x]));
+        double const far = far_row[cell_x] + (tx * (far_row[cell_x + 1] - far_row[cell_x]));
+        densities[j] = near + (tz * (far - near));
+    }
 }
@@ -2,13 +2,37 @@
 
 #include "src/world/chunk.h"
 #include "src/world/level.h"
+#include "src/util/thread_pool.h"
+
+// Bump whenever generating or smoothing starts making different terrain, so cached terrain from older builds is not reused.
+#define LEVEL_GEN_VERSION 2
 
 typedef struct level_gen level_gen_t;
 
+// Terrain shape of one chunk column, computed once and shared by every chunk stacked in it.
+typedef struct level_gen_column {
+    // Y of the surface tile, indexed by local Z then X. Everything below it is stone.
+    size_t heights[CHUNK_SIZE * CHUNK_SIZE];
+    tile_t surface_tiles[CHUNK_SIZE * CHUNK_SIZE];
+} level_gen_column_t;
+
 level_gen_t* const level_gen_new(uint64_t const seed);
 
 void level_gen_delete(level_gen_t* const self);
 
-void level_gen_generate(level_gen_t* const self, chunk_t* const chunk);
+void level_gen_shape_column(level_gen_t const* const self, pos_chunks_t const chunk_x, pos_chunks_t const chunk_z, level_gen_column_t* const column);
+
+// The column must have been shaped at the chunk's X and Z.
+// Adds the time spent sampling cave noise to *noise_ns, unless it is nullptr.
+void level_gen_generate(level_gen_t const* const self, level_gen_column_t const* const column, chunk_t* const chunk, uint64_t* const noise_ns);
+
+// The pool may be nullptr, in which case everything runs on the calling thread.
+void level_gen_smooth(level_gen_t const* const self, level_t* const level, thread_pool_t* const pool);
+
+// Smooths the tile columns from (min_x, min_z) up to but excluding (max_x, max_z), reading one tile past the edges.
+// The result is exactly that of smoothing the columns one at a time, Z-major, however many threads the pool has.
+void level_gen_smooth_region(level_gen_t const* const self, level_t* const level, thread_pool_t* const pool, pos_tiles_t const min_x, pos_tiles_t const min_z, pos_tiles_t const max_x, pos_tiles_t const max_z);
 
-void level_gen_smooth(level_gen_t const* const self, level_t* const level);
\ No newline at end of file
+// Fixes up the shapes of the tiles that an edit at pos can affect, in its own tile column and the ones around it, picking them as smoothing would.
+// Unlike smoothing it never changes tiles, and only the chunks whose shapes actually change are touched.
+void level_gen_reshape_around(level_gen_t const* const self, level_t* const level, pos_tiles_t const pos[NUM_AXES]);
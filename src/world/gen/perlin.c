@@ -2,14 +2,62 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include "src/util/object_counter.h"
 #include "src/util/random.h"
 #include "src/util/logger.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_AVX2 1
+#endif
+
+// Points along a row evaluated together: one AVX2 register of doubles, or two SSE2 or NEON ones.
+#define LANES 4
+
+// Vector forms of fade and lerp, with the same operation order.
+#define FADE_LANES(t) ((t) * (t) * (t) * ((t) * ((t) * 6.0 - 15.0) + 10.0))
+#define LERP_LANES(t, a, b) ((a) + (t) * ((b) - (a)))
+// X and Y terms of a gradient dot product, given the corner's coefficients.
+#define GRAD_LANES(coefs, x, y) ((coefs)[0] * (x) + (coefs)[1] * (y))
+#define SPLAT_LANES(c) { (c), (c), (c), (c) }
+#define GRADIENT_LANES(x, y, z) { SPLAT_LANES(x), SPLAT_LANES(y), SPLAT_LANES(z) }
+
+static_assert(LANES == 4, "SPLAT_LANES must fill every lane");
+
+/* BATCHING:
+ *     The grid functions walk rows along X, so Y and Z and everything
+ *     derived from them stay fixed across a row. Hashing stays scalar, and
+ *     is only redone when a row moves into another unit cube. The fade
+ *     curves, gradients and blending run on LANES points at once with GCC
+ *     vector extensions, each gradient as a dot product with the corner's
+ *     row of GRADIENTS. The kernel keeps the double precision and the
+ *     operation order of perlin_get_3d, so batched and single lookups
+ *     agree up to the sign of zero and the terrain of existing seeds does
+ *     not move.
+ *
+ *     The same kernel is compiled for the baseline target, which the
+ *     compiler lowers to SSE2, NEON or plain scalar code, and on x86 a
+ *     second time for AVX2, picked in perlin_new if the CPU supports it.
+ */
+
+typedef double lanes_t __attribute__((vector_size(LANES * sizeof(double))));
+
+// Evaluates n points starting at x0 and spaced by step along X, at a fixed Y and Z.
+typedef void (*row_filler_t)(uint8_t const p[512], size_t const n, double const x0, double const step, double const y, double const z, bool const is_3d, double* const out);
+
 struct perlin {
     uint8_t p[512];
+    row_filler_t fill_row;
+};
+
+// The directions grad picks for the low 4 bits of a hash, as coefficients of x, y and z copied into every lane.
+static lanes_t const GRADIENTS[16][3] = {
+    GRADIENT_LANES( 1,  1,  0), GRADIENT_LANES(-1,  1,  0), GRADIENT_LANES( 1, -1,  0), GRADIENT_LANES(-1, -1,  0),
+    GRADIENT_LANES( 1,  0,  1), GRADIENT_LANES(-1,  0,  1), GRADIENT_LANES( 1,  0, -1), GRADIENT_LANES(-1,  0, -1),
+    GRADIENT_LANES( 0,  1,  1), GRADIENT_LANES( 0, -1,  1), GRADIENT_LANES( 0,  1, -1), GRADIENT_LANES( 0, -1, -1),
+    GRADIENT_LANES( 1,  1,  0), GRADIENT_LANES( 0, -1,  1), GRADIENT_LANES(-1,  1,  0), GRADIENT_LANES( 0, -1, -1)
 };
 
 static double fade(double t);
@@ -18,6 +66,16 @@ static double lerp(double t, double a, double b);
 
 static double grad(int hash, double x, double y, double z);
 
+static void fill_row(uint8_t const p[512], size_t const n, double const x0, double const step, double const y, double const z, bool const is_3d, double* const out);
+
+#if USE_AVX2
+__attribute__((target("avx2"))) static void fill_row_avx2(uint8_t const p[512], size_t const n, double const x0, double const step, double const y, double const z, bool const is_3d, double* const out);
+#endif
+
+static inline __attribute__((always_inline)) void fill_row_lanes(uint8_t const p[512], size_t const n, double const x0, double const step, double const y, double const z, bool const is_3d, double* const out);
+
+static void hash_corners(uint8_t const p[512], int const X, int const Y, int const Z, uint8_t hashes[8]);
+
 perlin_t* const perlin_new(uint64_t const seed) {
     perlin_t* const self = malloc(sizeof(perlin_t));
     assert(self != nullptr);
@@ -41,6 +99,12 @@ perlin_t* const perlin_new(uint64_t const seed) {
 
     random_delete(rand);
 
+#if USE_AVX2
+    self->fill_row = __builtin_cpu_supports("avx2") ? fill_row_avx2 : fill_row;
+#else
+    self->fill_row = fill_row;
+#endif
+
     OBJ_CTR_INC(perlin_t);
 
     return self;
@@ -88,6 +152,27 @@ double perlin_get_3d(perlin_t const* const self, double x, double y, double z) {
                                    grad(self->p[BB+1], x-1, y-1, z-1 ))));
 }
 
+void perlin_fill_grid_2d(perlin_t const* const self, double const origin[2], double const step[2], size_t const size[2], double* const out) {
+    assert(self != nullptr);
+    assert(out != nullptr);
+
+    for (size_t j = 0; j < size[1]; j++) {
+        self->fill_row(self->p, size[0], origin[0], step[0], origin[1] + (double) j * step[1], 0, false, &(out[j * size[0]]));
+    }
+}
+
+void perlin_fill_grid_3d(perlin_t const* const self, double const origin[3], double const step[3], size_t const size[3], double* const out) {
+    assert(self != nullptr);
+    assert(out != nullptr);
+
+    for (size_t k = 0; k < size[2]; k++) {
+        double const z = origin[2] + (double) k * step[2];
+        for (size_t j = 0; j < size[1]; j++) {
+            self->fill_row(self->p, size[0], origin[0], step[0], origin[1] + (double) j * step[1], z, true, &(out[((k * size[1]) + j) * size[0]]));
+        }
+    }
+}
+
 static double fade(double t) {
     return t * t * t * (t * (t * 6 - 15) + 10);
 }
@@ -102,3 +187,116 @@ static double grad(int hash, double x, double y, double z) {
                v = h<4 ? y : h==12||h==14 ? x : z;
         return ((h&1) == 0 ? u : -u) + ((h&2) == 0 ? v : -v);
 }
+
+static void fill_row(uint8_t const p[512], size_t const n, double const x0, double const step, double const y, double const z, bool const is_3d, double* const out) {
+    fill_row_lanes(p, n, x0, step, y, z, is_3d, out);
+}
+
+#if USE_AVX2
+__attribute__((target("avx2"))) static void fill_row_avx2(uint8_t const p[512], size_t const n, double const x0, double const step, double const y, double const z, bool const is_3d, double* const out) {
+    fill_row_lanes(p, n, x0, step, y, z, is_3d, out);
+}
+#endif
+
+static inline __attribute__((always_inline)) void fill_row_lanes(uint8_t const p[512], size_t const n, double const x0, double const step, double const y, double const z, bool const is_3d, double* const out) {
+    int const Y = (int)floor(y) & 255;
+    int const Z = (int)floor(z) & 255;
+    lanes_t const fy = (lanes_t) {} + (y - floor(y));
+    lanes_t const fz = (lanes_t) {} + (z - floor(z));
+    lanes_t const fy1 = fy - 1.0;
+    lanes_t const fz1 = fz - 1.0;
+    lanes_t const v = FADE_LANES(fy);
+    lanes_t const w = FADE_LANES(fz);
+    size_t const num_corners = is_3d ? 8 : 4;
+
+    int cell_X = -1;
+    uint8_t cell_hashes[8];
+
+    for (size_t i = 0; i < n; i += LANES) {
+        double fx_lanes[LANES];
+        int X_lanes[LANES];
+        bool is_one_cell = true;
+        for (size_t l = 0; l < LANES; l++) {
+            // Lanes past the end of the row repeat its last point.
+            double const x = x0 + (double) (i + l < n ? i + l : n - 1) * step;
+            // floor, without a libm call on targets that have no rounding instruction.
+            int xi = (int) x;
+            if (x < xi) {
+                xi--;
+            }
+            fx_lanes[l] = x - xi;
+            X_lanes[l] = xi & 255;
+            is_one_cell = is_one_cell && X_lanes[l] == X_lanes[0];
+        }
+
+        // Corner c lies at +1 along X if bit 0 is set, along Y if bit 1 is set and along Z if bit 2 is set.
+        // Each points at the corner's gradient coefficients for x, y and z.
+        lanes_t const* coefs[8];
+        lanes_t mixed_coefs[8][3];
+        if (is_one_cell) {
+            if (X_lanes[0] != cell_X) {
+                hash_corners(p, X_lanes[0], Y, Z, cell_hashes);
+                cell_X = X_lanes[0];
+            }
+            for (size_t c = 0; c < num_corners; c++) {
+                coefs[c] = GRADIENTS[cell_hashes[c] & 15];
+            }
+        } else {
+            // Lanes straddle unit cubes, so their coefficients have to be gathered one by one.
+            double coef_lanes[8][3][LANES];
+            for (size_t l = 0; l < LANES; l++) {
+                if (X_lanes[l] != cell_X) {
+                    hash_corners(p, X_lanes[l], Y, Z, cell_hashes);
+                    cell_X = X_lanes[l];
+                }
+                for (size_t c = 0; c < num_corners; c++) {
+                    for (size_t a = 0; a < 3; a++) {
+                        coef_lanes[c][a][l] = GRADIENTS[cell_hashes[c] & 15][a][0];
+                    }
+                }
+            }
+            memcpy(mixed_coefs, coef_lanes, sizeof(coef_lanes[0]) * num_corners);
+            for (size_t c = 0; c < num_corners; c++) {
+                coefs[c] = mixed_coefs[c];
+            }
+        }
+
+        lanes_t fx;
+        memcpy(&fx, fx_lanes, sizeof(fx));
+        lanes_t const fx1 = fx - 1.0;
+        lanes_t const u = FADE_LANES(fx);
+
+        // Exactly one of the coefficients is 0, so each sum has the same value as grad's. Z only adds zeros in 2D.
+        lanes_t result = LERP_LANES(v, LERP_LANES(u, GRAD_LANES(coefs[0], fx , fy ),
+                                                     GRAD_LANES(coefs[1], fx1, fy )),
+                                       LERP_LANES(u, GRAD_LANES(coefs[2], fx , fy1),
+                                                     GRAD_LANES(coefs[3], fx1, fy1)));
+        if (is_3d) {
+            result = LERP_LANES(v, LERP_LANES(u, GRAD_LANES(coefs[0], fx , fy ) + coefs[0][2] * fz,
+                                                 GRAD_LANES(coefs[1], fx1, fy ) + coefs[1][2] * fz),
+                                   LERP_LANES(u, GRAD_LANES(coefs[2], fx , fy1) + coefs[2][2] * fz,
+                                                 GRAD_LANES(coefs[3], fx1, fy1) + coefs[3][2] * fz));
+            result = LERP_LANES(w, result,
+                                LERP_LANES(v, LERP_LANES(u, GRAD_LANES(coefs[4], fx , fy ) + coefs[4][2] * fz1,
+                                                            GRAD_LANES(coefs[5], fx1, fy ) + coefs[5][2] * fz1),
+                                              LERP_LANES(u, GRAD_LANES(coefs[6], fx , fy1) + coefs[6][2] * fz1,
+                                                            GRAD_LANES(coefs[7], fx1, fy1) + coefs[7][2] * fz1)));
+        }
+
+        memcpy(&(out[i]), &result, sizeof(double) * (n - i < LANES ? n - i : LANES));
+    }
+}
+
+// The hashes of the corners of the unit cube at (X, Y, Z), in the order perlin_get_3d blends them.
+static void hash_corners(uint8_t const p[512], int const X, int const Y, int const Z, uint8_t hashes[8]) {
+    int const A = p[X  ]+Y, AA = p[A]+Z, AB = p[A+1]+Z,
+              B = p[X+1]+Y, BA = p[B]+Z, BB = p[B+1]+Z;
+    hashes[0] = p[AA  ];
+    hashes[1] = p[BA  ];
+    hashes[2] = p[AB  ];
+    hashes[3] = p[BB  ];
+    hashes[4] = p[AA+1];
+    hashes[5] = p[BA+1];
+    hashes[6] = p[AB+1];
+    hashes[7] = p[BB+1];
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct perlin perlin_t;
@@ -13,3 +14,10 @@ double perlin_get_1d(perlin_t const* const self, double const x);
 double perlin_get_2d(perlin_t const* const self, double const x, double const y);
 
 double perlin_get_3d(perlin_t const* const self, double const x, double const y, double const z);
+
+// Fills out[j * size[0] + i] with perlin_get_2d at origin + (i, j) * step, evaluating a row several points at a time.
+// Matches perlin_get_2d exactly, apart from the sign of zero.
+void perlin_fill_grid_2d(perlin_t const* const self, double const origin[2], double const step[2], size_t const size[2], double* const out);
+
+// Fills out[(k * size[1] + j) * size[0] + i] with perlin_get_3d at origin + (i, j, k) * step, likewise.
+void perlin_fill_grid_3d(perlin_t const* const self, double const origin[3], double const step[3], size_t const size[3], double* const out);
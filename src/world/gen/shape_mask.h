@@ -0,0 +1,11 @@
+#pragma once
+
+#include "src/world/side.h"
+
+// A neighbour mask has a bit for each solid face neighbour of a tile, by side, then one for each solid diagonal neighbour at the same height.
+#define SHAPE_MASK_SIDE(side) (1u << (side))
+#define SHAPE_MASK_NORTH_WEST (1u << (NUM_SIDES + 0))
+#define SHAPE_MASK_SOUTH_WEST (1u << (NUM_SIDES + 1))
+#define SHAPE_MASK_NORTH_EAST (1u << (NUM_SIDES + 2))
+#define SHAPE_MASK_SOUTH_EAST (1u << (NUM_SIDES + 3))
+#define NUM_SHAPE_MASKS (1u << (NUM_SIDES + 4))
@@ -0,0 +1,249 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "src/world/gen/shape_mask.h"
+#include "src/world/tile_shape.h"
+
+static_assert(NUM_TILE_SHAPES <= 16, "shape sets are written as 16 bit masks");
+
+typedef struct entry {
+    bool defined;
+    bool sides_present[NUM_SIDES];
+    bool has_extra;
+    struct {
+        bool north_west;
+        bool south_west;
+        bool north_east;
+        bool south_east;
+    } extra;
+} entry_t;
+
+static entry_t const SHAPE_LOOKUP[NUM_TILE_SHAPES] = {
+    [TILE_SHAPE__RAMP_NORTH] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = true,
+            [SIDE__SOUTH] = false,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = true,
+            [SIDE__EAST] = true
+        }
+    },
+    [TILE_SHAPE__RAMP_SOUTH] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = false,
+            [SIDE__SOUTH] = true,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = true,
+            [SIDE__EAST] = true
+        }
+    },
+    [TILE_SHAPE__RAMP_WEST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = true,
+            [SIDE__SOUTH] = true,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = true,
+            [SIDE__EAST] = false
+        }
+    },
+    [TILE_SHAPE__RAMP_EAST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = true,
+            [SIDE__SOUTH] = true,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = false,
+            [SIDE__EAST] = true
+        }
+    },
+    [TILE_SHAPE__CORNER_A_NORTH_WEST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = true,
+            [SIDE__SOUTH] = false,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = true,
+            [SIDE__EAST] = false
+        }
+    },
+    [TILE_SHAPE__CORNER_A_SOUTH_WEST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = false,
+            [SIDE__SOUTH] = true,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = true,
+            [SIDE__EAST] = false
+        }
+    },
+    [TILE_SHAPE__CORNER_A_NORTH_EAST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = true,
+            [SIDE__SOUTH] = false,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = false,
+            [SIDE__EAST] = true
+        }
+    },
+    [TILE_SHAPE__CORNER_A_SOUTH_EAST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = false,
+            [SIDE__SOUTH] = true,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = false,
+            [SIDE__EAST] = true
+        }
+    },
+    [TILE_SHAPE__CORNER_B_NORTH_WEST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = true,
+            [SIDE__SOUTH] = true,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = true,
+            [SIDE__EAST] = true
+        },
+        .has_extra = true,
+        .extra = {
+            .north_west = true,
+            .south_west = true,
+            .north_east = true,
+            .south_east = false
+        }
+    },
+    [TILE_SHAPE__CORNER_B_SOUTH_WEST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = true,
+            [SIDE__SOUTH] = true,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = true,
+            [SIDE__EAST] = true
+        },
+        .has_extra = true,
+        .extra = {
+            .north_west = true,
+            .south_west = true,
+            .north_east = false,
+            .south_east = true
+        }
+    },
+    [TILE_SHAPE__CORNER_B_NORTH_EAST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = true,
+            [SIDE__SOUTH] = true,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = true,
+            [SIDE__EAST] = true
+        },
+        .has_extra = true,
+        .extra = {
+            .north_west = true,
+            .south_west = false,
+            .north_east = true,
+            .south_east = true
+        }
+    },
+    [TILE_SHAPE__CORNER_B_SOUTH_EAST] = {
+        .defined = true,
+        .sides_present = {
+            [SIDE__NORTH] = true,
+            [SIDE__SOUTH] = true,
+            [SIDE__BOTTOM] = true,
+            [SIDE__TOP] = false,
+            [SIDE__WEST] = true,
+            [SIDE__EAST] = true
+        },
+        .has_extra = true,
+        .extra = {
+            .north_west = false,
+            .south_west = true,
+            .north_east = true,
+            .south_east = true
+        }
+    }
+};
+
+static bool fits(tile_shape_t const tile_shape, unsigned const mask);
+
+// Writes the header holding SHAPE_TABLE, which level_gen uses in place of the patterns above, to the path given.
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <output>\n", argv[0]);
+        return 1;
+    }
+
+    FILE* const file = fopen(argv[1], "w");
+    if (file == nullptr) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    unsigned defined_shapes = 0;
+    for (tile_shape_t i = 0; i < NUM_TILE_SHAPES; i++) {
+        if (SHAPE_LOOKUP[i].defined) {
+            defined_shapes |= 1u << i;
+        }
+    }
+
+    fprintf(file, "// Generated by shape_table_gen, do not edit.\n");
+    fprintf(file, "#pragma once\n\n");
+    fprintf(file, "#include <stdint.h>\n\n");
+    fprintf(file, "#include \"src/world/gen/shape_mask.h\"\n\n");
+    fprintf(file, "// Bit i is set if tile shape i has a pattern at all.\n");
+    fprintf(file, "#define DEFINED_SHAPES 0x%04xu\n\n", defined_shapes);
+    fprintf(file, "// Bit i of entry m is set if tile shape i fits a tile with neighbour mask m.\n");
+    fprintf(file, "static uint16_t const SHAPE_TABLE[NUM_SHAPE_MASKS] = {");
+    for (unsigned mask = 0; mask < NUM_SHAPE_MASKS; mask++) {
+        unsigned shapes = 0;
+        for (tile_shape_t i = 0; i < NUM_TILE_SHAPES; i++) {
+            if (fits(i, mask)) {
+                shapes |= 1u << i;
+            }
+        }
+        fprintf(file, "%s0x%04x%s", (mask % 8 == 0) ? "\n    " : " ", shapes, (mask + 1 < NUM_SHAPE_MASKS) ? "," : "\n");
+    }
+    fprintf(file, "};\n");
+
+    return fclose(file) == 0 ? 0 : 1;
+}
+
+static bool fits(tile_shape_t const tile_shape, unsigned const mask) {
+    entry_t const* const entry = &(SHAPE_LOOKUP[tile_shape]);
+    if (!entry->defined) {
+        return false;
+    }
+
+    for (side_t i = 0; i < NUM_SIDES; i++) {
+        if (entry->sides_present[i] != ((mask & SHAPE_MASK_SIDE(i)) != 0)) {
+            return false;
+        }
+    }
+
+    if (entry->has_extra) {
+        return entry->extra.north_west == ((mask & SHAPE_MASK_NORTH_WEST) != 0) &&
+            entry->extra.south_west == ((mask & SHAPE_MASK_SOUTH_WEST) != 0) &&
+            entry->extra.north_east == ((mask & SHAPE_MASK_NORTH_EAST) != 0) &&
+            entry->extra.south_east == ((mask & SHAPE_MASK_SOUTH_EAST) != 0);
+    }
+
+    return true;
+}
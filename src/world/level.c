@@ -1,7 +1,10 @@
 #include "./level.h"
 
 #include <assert.h>
+#include <inttypes.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
 #include <string.h>
@@ -9,6 +12,7 @@
 #include "src/util/object_counter.h"
 #include "src/util/util.h"
 #include "src/world/chunk.h"
+#include "src/world/chunk_map.h"
 #include "src/world/entity/ecs.h"
 #include "src/world/entity/ecs_components.h"
 #include "src/world/entity/ecs_systems.h"
@@ -18,70 +22,191 @@
 #include "src/world/tile.h"
 #include "src/world/tile_shape.h"
 #include "src/world/gen/level_gen.h"
+#include "src/world/level_saver.h"
+#include "src/world/region_file.h"
 #include "src/util/random.h"
 #include "src/util/logger.h"
+#include "src/util/thread_pool.h"
+
+// Sizes and in-chunk positions are unsigned, so they are made signed before being mixed with positions.
+#define SIGNED(coord) ((ptrdiff_t) (coord))
+#define TO_CHUNK_SPACE(coord) ((pos_chunks_t) CHUNK_COORD(coord))
+#define TO_TILE_SPACE(coord) ((pos_tiles_t) (coord) * CHUNK_SIZE)
+#define TO_CHUNK_SPACE_ARR(pos) ((pos_chunks_t[NUM_AXES]) { TO_CHUNK_SPACE(pos[AXIS__X]), TO_CHUNK_SPACE(pos[AXIS__Y]), TO_CHUNK_SPACE(pos[AXIS__Z]) })
+#define TO_POS_IN_CHUNK_ARR(pos) ((size_t[NUM_AXES]) { CHUNK_LOCAL(pos[AXIS__X]), CHUNK_LOCAL(pos[AXIS__Y]), CHUNK_LOCAL(pos[AXIS__Z]) })
+#define TO_TILE_POS_ARR(pos) ((pos_tiles_t[NUM_AXES]) { (pos_tiles_t) floorf(pos[AXIS__X]), (pos_tiles_t) floorf(pos[AXIS__Y]), (pos_tiles_t) floorf(pos[AXIS__Z]) })
+#define COLUMN_KEY_ARR(x, z) ((pos_chunks_t[NUM_AXES]) { (x), 0, (z) })
+
+// Direct-mapped on the low two bits of each chunk coordinate, so neighbouring chunks never evict each other.
+#define CHUNK_CACHE_SIZE 64
+#define CHUNK_CACHE_SLOT(pos) (((pos[AXIS__X]) & 3) | (((pos[AXIS__Z]) & 3) << 2) | (((pos[AXIS__Y]) & 3) << 4))
+
+// Number of chunk columns the lazy scheduler finalizes per level_tick.
+#define LAZY_COLUMNS_PER_TICK 4
+// Population gives up on a column after this many failed tree placements per tree.
+#define MAX_TREE_ATTEMPTS 8
+// Unbounded levels spread NUM_TREES and NUM_MOBS as if over a 16x16 column level.
+#define DECORATION_REFERENCE_COLUMNS 256
+
+#define LEVEL_DAT_NAME "/level.dat"
+#define LEVEL_DAT_VERSION 1
+
+typedef enum column_state {
+    // Terrain generated, but not yet smoothed or populated.
+    COLUMN_STATE__GENERATED,
+    // Smoothed and populated; the column is ready for use.
+    COLUMN_STATE__FINALIZED
+} column_state_t;
+
+typedef struct column {
+    column_state_t state;
+    // Set when the column is finalized or edited, and cleared once it is queued for saving.
+    bool needs_save;
+    // Once on disk, only chunks edited after saved_generation need writing again.
+    bool is_on_disk;
+    uint64_t saved_generation;
+    // One above the highest non-air tile of each tile column, indexed by local Z then X. 0 if the tile column is all air.
+    uint32_t surface_heights[CHUNK_SIZE * CHUNK_SIZE];
+    uint64_t chunk_generations[];
+} column_t;
+
+// Shared by the tasks generating an eager level's columns.
+typedef struct level_gen_job {
+    level_gen_t const* level_gen;
+    size_chunks_t height;
+    // Each column's chunks in order of Y, one column after another.
+    chunk_t** chunks;
+    atomic_uint_least64_t noise_ns;
+    atomic_uint_least64_t fill_ns;
+} level_gen_job_t;
+
+typedef enum feature_type {
+    FEATURE_TYPE__TREE,
+    FEATURE_TYPE__MOB
+} feature_type_t;
+
+typedef struct feature {
+    feature_type_t type;
+    float pos[NUM_AXES];
+    float rot_y;
+} feature_t;
+
+// The trees and mobs of one chunk column, worked out from that column alone with a random seeded from its position.
+typedef struct decoration {
+    size_t num_features;
+    feature_t* features;
+} decoration_t;
+
+// Shared by the tasks decorating an eager level's columns, laid out like level_gen_job_t.
+typedef struct decoration_job {
+    level_t const* level;
+    column_t const** columns;
+    chunk_t** chunks;
+    decoration_t* decorations;
+} decoration_job_t;
 
-#define CHUNK_INDEX(pos) (((pos[AXIS__Y]) * self->size[AXIS__Z] * self->size[AXIS__X]) + ((pos[AXIS__Z]) * self->size[AXIS__X]) + (pos[AXIS__X]))
-#define TO_CHUNK_SPACE(coord) ((coord) / CHUNK_SIZE)
-#define TO_TILE_SPACE(coord) ((coord) * CHUNK_SIZE)
-#define TO_CHUNK_SPACE_ARR(pos) ((size_chunks_t[NUM_AXES]) { pos[AXIS__X] / CHUNK_SIZE, pos[AXIS__Y] / CHUNK_SIZE, pos[AXIS__Z] / CHUNK_SIZE })
-#define TO_TILE_SPACE_ARR(pos) ((size_t[NUM_AXES]) { pos[AXIS__X] * CHUNK_SIZE, pos[AXIS__Y] * CHUNK_SIZE, pos[AXIS__Z] * CHUNK_SIZE }) 
-#define TO_POS_IN_CHUNK_ARR(pos) ((size_t[NUM_AXES]) { pos[AXIS__X] % CHUNK_SIZE, pos[AXIS__Y] % CHUNK_SIZE, pos[AXIS__Z] % CHUNK_SIZE }) 
+typedef struct chunk_cache_entry {
+    pos_chunks_t pos[NUM_AXES];
+    chunk_t* chunk;
+} chunk_cache_entry_t;
+
+typedef struct observer {
+    bool active;
+    float pos[NUM_AXES];
+    size_chunks_t radius;
+} observer_t;
 
 struct level {
     size_chunks_t size[NUM_AXES];
-    chunk_t** chunks;
-    bool* is_chunk_dirty;
+    chunk_map_t* chunks;
+    chunk_map_t* columns;
+    chunk_cache_entry_t chunk_cache[CHUNK_CACHE_SIZE];
     level_gen_t* level_gen;
     ecs_t* ecs;
     uint64_t seed;
     random_t* rand;
+    bool lazy;
+    bool is_finalizing;
+    observer_t observers[MAX_LEVEL_OBSERVERS];
+    uint64_t generation;
+    // Ring of the most recent edits. journal_length counts every entry ever appended.
+    level_change_t journal[LEVEL_JOURNAL_SIZE];
+    size_t journal_length;
+    uint64_t journal_evicted_generation;
+    // World directory the level was loaded from or last saved to, if any.
+    char* path;
+    // Region files opened so far, keyed like columns by region coordinate.
+    chunk_map_t* regions;
+    // Columns with needs_save set, so saving never has to visit the whole level.
+    chunk_map_t* unsaved_columns;
+    // Started by the first save.
+    level_saver_t* saver;
+    level_gen_stats_t gen_stats;
 };
 
-level_t* const level_new(size_chunks_t const size[NUM_AXES]) {
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        assert(size[a] > 0);
-    }
-
-    LOG_DEBUG("level_t: creating new level [%zu x %zu x %zu].", size[AXIS__X], size[AXIS__Y], size[AXIS__Z]);
+static bool const is_coord_oob(level_t const* const self, axis_t const axis, ptrdiff_t const coord, ptrdiff_t const scale);
+static bool const is_chunk_oob(level_t const* const self, pos_chunks_t const pos[NUM_AXES]);
+static column_t* const generate_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z);
+static void generate_column_task(void* const arg, size_t const index);
+static column_t* const add_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z, column_state_t const state);
+static column_t* const load_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z);
+static region_file_t* const get_region(level_t* const self, pos_chunks_t const x, pos_chunks_t const z);
+static char* const get_region_path(char const* const dir, pos_chunks_t const x, pos_chunks_t const z);
+static void mark_column_unsaved(level_t* const self, column_t* const column, pos_chunks_t const x, pos_chunks_t const z);
+static bool const write_level_dat(level_t const* const self, char const* const path);
+static bool const read_level_dat(char const* const path, level_settings_t* const settings);
+static void finalize_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z);
+static void populate_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z);
+static void bump_chunk_generation(level_t* const self, pos_chunks_t const pos[NUM_AXES]);
+static void mark_chunk_changed(level_t* const self, pos_chunks_t const pos[NUM_AXES], size_t const local_min[NUM_AXES], size_t const local_max[NUM_AXES]);
+static void mark_tile_changed(level_t* const self, pos_tiles_t const pos[NUM_AXES]);
+static void compute_surface_heights(level_t const* const self, column_t* const column, pos_chunks_t const x, pos_chunks_t const z);
+static void update_surface_height(level_t* const self, pos_tiles_t const x, pos_tiles_t const z, pos_tiles_t const top);
+static bool const clip_region_to_chunk(pos_tiles_t const min[NUM_AXES], pos_tiles_t const max[NUM_AXES], size_t const strides[NUM_AXES], pos_chunks_t const chunk_pos[NUM_AXES], size_t local_min[NUM_AXES], size_t local_max[NUM_AXES], size_t* const offset);
+static void generate_near_observers(level_t* const self, size_t const budget);
+static uint64_t const get_column_seed(level_t const* const self, pos_chunks_t const x, pos_chunks_t const z);
+static void plan_decoration(level_t const* const self, pos_chunks_t const x, pos_chunks_t const z, column_t const* const column, chunk_t* const* const chunks, decoration_t* const decoration);
+static void plan_decoration_task(void* const arg, size_t const index);
+static bool const plan_tree(pos_chunks_t const x, pos_chunks_t const z, column_t const* const column, chunk_t* const* const chunks, size_t const lx, size_t const lz, float pos[NUM_AXES]);
+static void add_decoration(level_t* const self, decoration_t const* const decoration);
+static char* const get_cache_path(level_t const* const self, char const* const dir);
+static bool const read_cache(level_t* const self, char const* const path, chunk_t** const chunks);
+static void write_cache(level_t* const self, char const* const dir, char const* const path);
+
+level_t* const level_new(level_settings_t const* const settings) {
+    assert(settings != nullptr);
+    size_chunks_t const* const size = settings->size;
+    // Only lazy levels may leave X and Z unbounded (0); the height is always fixed.
+    assert(size[AXIS__Y] > 0);
+    assert(settings->lazy || (size[AXIS__X] > 0 && size[AXIS__Z] > 0));
+
+    LOG_DEBUG("level_t: creating new %s level [%zu x %zu x %zu].", settings->lazy ? "lazy" : "eager", size[AXIS__X], size[AXIS__Y], size[AXIS__Z]);
 
     level_t* const self = malloc(sizeof(level_t));
     assert(self != nullptr);
 
     memcpy(self->size, size, sizeof(size_chunks_t) * NUM_AXES);
 
-    self->seed = (uint64_t) get_time_ms();
+    self->seed = settings->seed;
     self->level_gen = level_gen_new(self->seed);
+    self->lazy = settings->lazy;
+    self->is_finalizing = false;
+    memset(self->chunk_cache, 0, sizeof(self->chunk_cache));
+    memset(self->observers, 0, sizeof(self->observers));
+    self->generation = 0;
+    self->journal_length = 0;
+    self->journal_evicted_generation = 0;
+    self->path = nullptr;
+    self->regions = chunk_map_new(0);
+    self->unsaved_columns = chunk_map_new(0);
+    self->saver = nullptr;
+    self->gen_stats = (level_gen_stats_t) { 0 };
 
     uint64_t const start_time = get_time_ms();
+    uint64_t const start_time_ns = get_time_ns();
 
-    self->chunks = malloc(sizeof(chunk_t*) * size[AXIS__X] * size[AXIS__Y] * size[AXIS__Z]);
-    assert(self->chunks != nullptr);
-
-    LOG_DEBUG("level_t: allocated %zu chunks.", size[AXIS__X] * size[AXIS__Y] * size[AXIS__Z]);
-
-    for (size_chunks_t x = 0; x < size[AXIS__X]; x++) {
-        for (size_chunks_t y = 0; y < size[AXIS__Y]; y++) {
-            for (size_chunks_t z = 0; z < size[AXIS__Z]; z++) {
-                size_chunks_t const i_pos[NUM_AXES] = { x, y, z };
-                self->chunks[CHUNK_INDEX(i_pos)] = chunk_new(i_pos);
-                level_gen_generate(self->level_gen, self->chunks[CHUNK_INDEX(i_pos)]);                
-            }
-        }
-    }
-
-    self->is_chunk_dirty = malloc(sizeof(bool) * size[AXIS__X] * size[AXIS__Y] * size[AXIS__Z]);
-    assert(self->is_chunk_dirty != nullptr);
-    for (size_chunks_t x = 0; x < size[AXIS__X]; x++) {
-        for (size_chunks_t y = 0; y < size[AXIS__Y]; y++) {
-            for (size_chunks_t z = 0; z < size[AXIS__Z]; z++) {
-                size_chunks_t const i_pos[NUM_AXES] = { x, y, z };
-                self->is_chunk_dirty[CHUNK_INDEX(i_pos)] = false;
-            }
-        }
-    }
-
-    level_gen_smooth(self->level_gen, self);
+    self->chunks = chunk_map_new(self->lazy ? 0 : size[AXIS__X] * size[AXIS__Y] * size[AXIS__Z] * 2);
+    self->columns = chunk_map_new(self->lazy ? 0 : size[AXIS__X] * size[AXIS__Z] * 2);
 
     self->ecs = ecs_new();
     ecs_attach_system(self->ecs, ECS_COMPONENT__VEL, ecs_system_velocity);
@@ -90,75 +215,100 @@ level_t* const level_new(size_chunks_t const size[NUM_AXES]) {
     ecs_attach_system(self->ecs, ECS_COMPONENT__MOVE_RANDOM, ecs_system_move_random);
 
     self->rand = random_new(self->seed);
-    for (size_t i = 0; i < NUM_TREES; i++) {
-        size_t i_tree_pos[NUM_AXES] = {
-            random_next_int_bounded(self->rand, self->size[AXIS__X] * CHUNK_SIZE - 1),
-            0,
-            random_next_int_bounded(self->rand, self->size[AXIS__Z] * CHUNK_SIZE - 1)
-        };
-        for (size_t y = (self->size[AXIS__Y] * CHUNK_SIZE) - 1; y >= 0; y--) {
-            i_tree_pos[AXIS__Y] = y;
-            if (level_get_tile(self, i_tree_pos) != TILE__AIR) {
-                i_tree_pos[AXIS__Y] = y + 1;
-                break;
-            }
-        }
 
-        size_t const below_pos[NUM_AXES] = { i_tree_pos[AXIS__X], i_tree_pos[AXIS__Y] - 1, i_tree_pos[AXIS__Z] };
+    if (self->lazy) {
+        uint64_t const end_time = get_time_ms();
+        LOG_DEBUG("level_t: set up lazy level in %lums.", end_time - start_time);
 
-        if (level_get_tile(self, below_pos) != TILE__GRASS) {
-            i--;
-            continue;
-        }
-        float y_offset = 0.0f;
-        tile_shape_t const below_tile_shape = level_get_tile_shape(self, below_pos);
-        if (below_tile_shape == TILE_SHAPE__RAMP_NORTH || below_tile_shape == TILE_SHAPE__RAMP_SOUTH || below_tile_shape == TILE_SHAPE__RAMP_WEST || below_tile_shape == TILE_SHAPE__RAMP_EAST) {
-            y_offset = -0.5f;
-        }
-        if (below_tile_shape == TILE_SHAPE__CORNER_A_NORTH_WEST || below_tile_shape == TILE_SHAPE__CORNER_A_SOUTH_WEST || below_tile_shape == TILE_SHAPE__CORNER_A_NORTH_EAST || below_tile_shape == TILE_SHAPE__CORNER_A_SOUTH_EAST) {
-            y_offset = -1.0f;
-        }
-
-        entity_t const tree = ecs_new_entity(self->ecs);
-        ecs_component_pos_t* const tree_pos = ecs_attach_component(self->ecs, tree, ECS_COMPONENT__POS);
-        ecs_component_sprite_t* const tree_sprite = ecs_attach_component(self->ecs, tree, ECS_COMPONENT__SPRITE);
+        OBJ_CTR_INC(level_t);
 
-        tree_pos->pos[AXIS__X] = i_tree_pos[AXIS__X] + 0.5f;
-        tree_pos->pos[AXIS__Y] = i_tree_pos[AXIS__Y] + y_offset;
-        tree_pos->pos[AXIS__Z] = i_tree_pos[AXIS__Z] + 0.5f;
-        
-        tree_sprite->sprite = SPRITE__TREE;
-        tree_sprite->scale = 0.05f;
+        return self;
     }
 
-    for (size_t i = 0; i < 100; i++) {
-        size_t i_mob_pos[NUM_AXES] = {
-            random_next_int_bounded(self->rand, self->size[AXIS__X] * CHUNK_SIZE - 1),
-            120,
-            random_next_int_bounded(self->rand, self->size[AXIS__Z] * CHUNK_SIZE - 1)
-        };
+    size_t const num_chunks = size[AXIS__X] * size[AXIS__Y] * size[AXIS__Z];
+    chunk_t** const chunks = malloc(sizeof(chunk_t*) * num_chunks);
+    assert(chunks != nullptr);
+
+    thread_pool_t* const pool = thread_pool_new(settings->num_threads);
+    self->gen_stats.num_threads = thread_pool_get_num_threads(pool);
+
+    uint64_t stage_start = get_time_ns();
+    char* const cache_path = settings->cache_path != nullptr ? get_cache_path(self, settings->cache_path) : nullptr;
+    bool const is_cached = cache_path != nullptr && read_cache(self, cache_path, chunks);
+    if (is_cached) {
+        LOG_DEBUG("level_t: read %zu chunks from %s.", num_chunks, cache_path);
+    } else {
+        // Chunks are created and mapped up front, so the pool only runs the generator, which writes to nothing but the column's own chunks.
+        size_t num_created = 0;
+        for (pos_chunks_t z = 0; z < (pos_chunks_t) size[AXIS__Z]; z++) {
+            for (pos_chunks_t x = 0; x < (pos_chunks_t) size[AXIS__X]; x++) {
+                for (pos_chunks_t y = 0; y < (pos_chunks_t) size[AXIS__Y]; y++) {
+                    chunk_t* const chunk = chunk_new((pos_chunks_t[NUM_AXES]) { x, y, z });
+                    chunk_map_put(self->chunks, (pos_chunks_t[NUM_AXES]) { x, y, z }, chunk);
+                    chunks[num_created++] = chunk;
+                }
+            }
+        }
 
-        entity_t const mob = ecs_new_entity(self->ecs);
-        ecs_component_pos_t* const mob_pos = ecs_attach_component(self->ecs, mob, ECS_COMPONENT__POS);
-        ecs_component_rot_t* const mob_rot = ecs_attach_component(self->ecs, mob, ECS_COMPONENT__ROT);
-        ecs_component_aabb_t* const mob_aabb = ecs_attach_component(self->ecs, mob, ECS_COMPONENT__AABB);
-        ecs_attach_component(self->ecs, mob, ECS_COMPONENT__GRAVITY);
-        ecs_attach_component(self->ecs, mob, ECS_COMPONENT__VEL);
-        ecs_component_sprite_t* const mob_sprite = ecs_attach_component(self->ecs, mob, ECS_COMPONENT__SPRITE);
-        ecs_attach_component(self->ecs, mob, ECS_COMPONENT__MOVE_RANDOM);
+        level_gen_job_t gen_job = { .level_gen = self->level_gen, .height = size[AXIS__Y], .chunks = chunks };
+        atomic_init(&(gen_job.noise_ns), 0);
+        atomic_init(&(gen_job.fill_ns), 0);
+        thread_pool_run(pool, size[AXIS__X] * size[AXIS__Z], generate_column_task, &gen_job);
+        self->gen_stats.noise_cpu_ns = atomic_load(&(gen_job.noise_ns));
+        self->gen_stats.fill_cpu_ns = atomic_load(&(gen_job.fill_ns));
+        LOG_DEBUG("level_t: generated %zu chunks on %zu threads.", num_chunks, thread_pool_get_num_threads(pool));
+    }
 
-        mob_pos->pos[AXIS__X] = i_mob_pos[AXIS__X] + 0.5f;
-        mob_pos->pos[AXIS__Y] = i_mob_pos[AXIS__Y];
-        mob_pos->pos[AXIS__Z] = i_mob_pos[AXIS__Z] + 0.5f;
+    size_t const num_columns = size[AXIS__X] * size[AXIS__Z];
+    column_t const** const columns = malloc(sizeof(column_t const*) * num_columns);
+    assert(columns != nullptr);
 
-        mob_rot->rot[ROT_AXIS__Y] = M_PI * 2 * random_next_float(self->rand);
+    size_t num_added = 0;
+    for (pos_chunks_t z = 0; z < (pos_chunks_t) size[AXIS__Z]; z++) {
+        for (pos_chunks_t x = 0; x < (pos_chunks_t) size[AXIS__X]; x++) {
+            columns[num_added++] = add_column(self, x, z, COLUMN_STATE__GENERATED);
+        }
+    }
+    self->gen_stats.generate_ns = get_time_ns() - stage_start;
+
+    stage_start = get_time_ns();
+    if (!is_cached) {
+        level_gen_smooth(self->level_gen, self, pool);
+    }
 
-        aabb_set_bounds(mob_aabb->aabb, (float[NUM_AXES]) { -0.4f, 0.0f, -0.4f }, (float[NUM_AXES]) { 0.4f, 1.8f, 0.4f });
+    size_t iter = 0;
+    pos_chunks_t column_pos[NUM_AXES];
+    void* column;
+    while (chunk_map_next(self->columns, &iter, column_pos, &column)) {
+        ((column_t*) column)->state = COLUMN_STATE__FINALIZED;
+        mark_column_unsaved(self, column, column_pos[AXIS__X], column_pos[AXIS__Z]);
+    }
+    self->gen_stats.smooth_ns = get_time_ns() - stage_start;
 
-        mob_sprite->sprite = SPRITE__MOB;
-        mob_sprite->scale = 0.075f;
+    if (cache_path != nullptr && !is_cached) {
+        write_cache(self, settings->cache_path, cache_path);
     }
+    free(cache_path);
+
+    // Planning only reads the column at hand, so it runs on the pool. The entities are then added in column order, keeping their ids stable too.
+    decoration_t* const decorations = malloc(sizeof(decoration_t) * num_columns);
+    assert(decorations != nullptr);
+    stage_start = get_time_ns();
+    thread_pool_run(pool, num_columns, plan_decoration_task, &((decoration_job_t) { self, columns, chunks, decorations }));
+    thread_pool_delete(pool);
+    self->gen_stats.decorate_ns = get_time_ns() - stage_start;
+
+    stage_start = get_time_ns();
+    for (size_t i = 0; i < num_columns; i++) {
+        add_decoration(self, &(decorations[i]));
+        free(decorations[i].features);
+    }
+    self->gen_stats.spawn_ns = get_time_ns() - stage_start;
+    free(decorations);
+    free(columns);
+    free(chunks);
 
+    self->gen_stats.total_ns = get_time_ns() - start_time_ns;
     uint64_t const end_time = get_time_ms();
     LOG_DEBUG("level_t: generated level in %lums.", end_time - start_time);
 
@@ -170,16 +320,32 @@ level_t* const level_new(size_chunks_t const size[NUM_AXES]) {
 void level_delete(level_t* const self) {
     assert(self != nullptr);
 
-    for (size_chunks_t x = 0; x < self->size[AXIS__X]; x++) {
-        for (size_chunks_t y = 0; y < self->size[AXIS__Y]; y++) {
-            for (size_chunks_t z = 0; z < self->size[AXIS__Z]; z++) {
-                size_chunks_t const i_pos[NUM_AXES] = { x, y, z };
-                chunk_delete(self->chunks[CHUNK_INDEX(i_pos)]);
-                self->chunks[CHUNK_INDEX(i_pos)] = nullptr;
-            }
-        }
+    if (self->saver != nullptr) {
+        level_saver_delete(self->saver);
     }
-    free(self->chunks);
+
+    size_t iter = 0;
+    void* value;
+    while (chunk_map_next(self->chunks, &iter, nullptr, &value)) {
+        chunk_delete(value);
+    }
+    chunk_map_delete(self->chunks);
+
+    iter = 0;
+    while (chunk_map_next(self->columns, &iter, nullptr, &value)) {
+        free(value);
+    }
+    chunk_map_delete(self->columns);
+
+    iter = 0;
+    while (chunk_map_next(self->regions, &iter, nullptr, &value)) {
+        region_file_close(value);
+    }
+    chunk_map_delete(self->regions);
+
+    chunk_map_delete(self->unsaved_columns);
+
+    free(self->path);
 
     random_delete(self->rand);
 
@@ -192,25 +358,123 @@ void level_delete(level_t* const self) {
     OBJ_CTR_DEC(level_t);
 }
 
+level_t* const level_load(char const* const path) {
+    assert(path != nullptr);
+
+    level_settings_t settings = { 0 };
+    if (!read_level_dat(path, &settings)) {
+        return nullptr;
+    }
+    settings.lazy = true;
+
+    level_t* const self = level_new(&settings);
+    self->path = strcata(path, "");
+
+    LOG_DEBUG("level_t: loaded level from %s.", path);
+
+    return self;
+}
+
+bool const level_save(level_t* const self, char const* const path) {
+    assert(self != nullptr);
+    assert(path != nullptr);
+    assert(self->path == nullptr || strcmp(self->path, path) == 0);
+
+    uint64_t const start_time = get_time_ms();
+
+    if (self->path == nullptr) {
+        if (!region_file_make_dir(path) || !write_level_dat(self, path)) {
+            return false;
+        }
+        self->path = strcata(path, "");
+    }
+    if (self->saver == nullptr) {
+        self->saver = level_saver_new();
+    }
+
+    // Snapshot the chunks edited since their column was last saved, grouped by region. Everything else is already on disk.
+    size_chunks_t const height = self->size[AXIS__Y];
+    chunk_map_t* const regions = chunk_map_new(0);
+    chunk_map_t* const still_unsaved = chunk_map_new(0);
+    size_t num_chunks = 0;
+
+    size_t iter = 0;
+    pos_chunks_t pos[NUM_AXES];
+    void* value;
+    while (chunk_map_next(self->unsaved_columns, &iter, pos, &value)) {
+        column_t* const column = value;
+        if (column->state != COLUMN_STATE__FINALIZED) {
+            chunk_map_put(still_unsaved, pos, column);
+            continue;
+        }
+
+        pos_chunks_t const region_key[NUM_AXES] = { REGION_COORD(pos[AXIS__X]), 0, REGION_COORD(pos[AXIS__Z]) };
+        chunk_t** chunks = chunk_map_get(regions, region_key);
+        if (chunks == nullptr) {
+            chunks = calloc(REGION_SIZE * height * REGION_SIZE, sizeof(chunk_t*));
+            assert(chunks != nullptr);
+            chunk_map_put(regions, region_key, chunks);
+        }
+
+        size_t const local_x = (size_t) (pos[AXIS__X] - (region_key[AXIS__X] * REGION_SIZE));
+        size_t const local_z = (size_t) (pos[AXIS__Z] - (region_key[AXIS__Z] * REGION_SIZE));
+        for (size_t y = 0; y < height; y++) {
+            if (!column->is_on_disk || column->chunk_generations[y] > column->saved_generation) {
+                chunks[REGION_INDEX(local_x, y, local_z)] = chunk_snapshot(chunk_map_get(self->chunks, (pos_chunks_t[NUM_AXES]) { pos[AXIS__X], (pos_chunks_t) y, pos[AXIS__Z] }));
+                num_chunks++;
+            }
+        }
+
+        column->needs_save = false;
+        column->is_on_disk = true;
+        column->saved_generation = self->generation;
+    }
+
+    chunk_map_delete(self->unsaved_columns);
+    self->unsaved_columns = still_unsaved;
+
+    iter = 0;
+    while (chunk_map_next(regions, &iter, pos, &value)) {
+        char* const region_path = get_region_path(self->path, pos[AXIS__X], pos[AXIS__Z]);
+        level_saver_queue_region(self->saver, region_path, height, value);
+        free(region_path);
+    }
+    level_saver_queue_sync(self->saver, self->path);
+
+    uint64_t const end_time = get_time_ms();
+    LOG_DEBUG("level_t: queued %zu chunks in %zu regions for saving in %lums.", num_chunks, chunk_map_get_size(regions), end_time - start_time);
+
+    chunk_map_delete(regions);
+
+    return true;
+}
+
 uint64_t const level_get_seed(level_t const* const self) {
     assert(self != nullptr);
 
     return self->seed;
 }
 
+void level_get_gen_stats(level_t const* const self, level_gen_stats_t* const stats) {
+    assert(self != nullptr);
+    assert(stats != nullptr);
+
+    *stats = self->gen_stats;
+}
+
 void level_get_size(level_t const* const self, size_chunks_t size[NUM_AXES]) {
     assert(self != nullptr);
 
     memcpy(size, self->size, sizeof(size_chunks_t) * NUM_AXES);
 }
 
-bool const level_is_tile_oob(level_t const* const self, size_t const pos[NUM_AXES]) {
+bool const level_is_tile_oob(level_t const* const self, pos_tiles_t const pos[NUM_AXES]) {
     assert(self != nullptr);
 
     return
-        (pos[AXIS__X] >= self->size[AXIS__X] * CHUNK_SIZE) ||
-        (pos[AXIS__Y] >= self->size[AXIS__Y] * CHUNK_SIZE) ||
-        (pos[AXIS__Z] >= self->size[AXIS__Z] * CHUNK_SIZE);
+        is_coord_oob(self, AXIS__X, pos[AXIS__X], CHUNK_SIZE) ||
+        is_coord_oob(self, AXIS__Y, pos[AXIS__Y], CHUNK_SIZE) ||
+        is_coord_oob(self, AXIS__Z, pos[AXIS__Z], CHUNK_SIZE);
 }
 
 random_t* const level_get_random(level_t* const self) {
@@ -219,84 +483,350 @@ random_t* const level_get_random(level_t* const self) {
     return self->rand;
 }
 
-bool const level_is_chunk_dirty(level_t const* const self, size_chunks_t const pos[NUM_AXES]) {
+uint64_t const level_get_generation(level_t const* const self) {
     assert(self != nullptr);
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        assert(pos[a] >= 0 && pos[a] < self->size[a]);
-    }
 
-    return self->is_chunk_dirty[CHUNK_INDEX(pos)];
+    return self->generation;
 }
 
-chunk_t* const level_get_chunk(level_t const* const self, size_chunks_t const pos[NUM_AXES]) {
+uint64_t const level_get_chunk_generation(level_t const* const self, pos_chunks_t const pos[NUM_AXES]) {
     assert(self != nullptr);
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        assert(pos[a] >= 0 && pos[a] < self->size[a]);
+    assert(!is_chunk_oob(self, pos));
+
+    column_t const* const column = chunk_map_get(self->columns, COLUMN_KEY_ARR(pos[AXIS__X], pos[AXIS__Z]));
+
+    return column != nullptr ? column->chunk_generations[pos[AXIS__Y]] : 0;
+}
+
+size_t const level_poll_changes(level_t const* const self, uint64_t* const since, level_change_t changes[], size_t const max_changes, bool* const overflowed) {
+    assert(self != nullptr);
+    assert(since != nullptr);
+    assert(changes != nullptr || max_changes == 0);
+    assert(overflowed != nullptr);
+
+    *overflowed = *since < self->journal_evicted_generation;
+    if (*overflowed) {
+        *since = self->journal_evicted_generation;
+    }
+
+    // Generations increase along the journal, so walk back from the newest entry to the first one the caller has not seen.
+    size_t const oldest = self->journal_length > LEVEL_JOURNAL_SIZE ? self->journal_length - LEVEL_JOURNAL_SIZE : 0;
+    size_t start = self->journal_length;
+    while (start > oldest && self->journal[(start - 1) % LEVEL_JOURNAL_SIZE].generation > *since) {
+        start--;
+    }
+
+    size_t num_changes = 0;
+    for (size_t i = start; i < self->journal_length && num_changes < max_changes; i++) {
+        level_change_t const* const change = &(self->journal[i % LEVEL_JOURNAL_SIZE]);
+        memcpy(&(changes[num_changes]), change, sizeof(level_change_t));
+        num_changes++;
+        *since = change->generation;
     }
 
-    return self->chunks[CHUNK_INDEX(pos)];
+    return num_changes;
 }
 
-tile_t const level_get_tile(level_t const* const self, size_t const pos[NUM_AXES]) {
+chunk_t* const level_get_chunk(level_t const* const self, pos_chunks_t const pos[NUM_AXES]) {
     assert(self != nullptr);
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        assert(pos[a] >= 0 && pos[a] < TO_TILE_SPACE(self->size[a]));
+    assert(!is_chunk_oob(self, pos));
+
+    // The cache and lazy generation are invisible to callers, so both are updated through a const handle.
+    level_t* const mutable_self = (level_t*) self;
+
+    chunk_cache_entry_t* const entry = &(mutable_self->chunk_cache[CHUNK_CACHE_SLOT(pos)]);
+    if (entry->chunk != nullptr && memcmp(entry->pos, pos, sizeof(pos_chunks_t) * NUM_AXES) == 0) {
+        return entry->chunk;
     }
 
+    if (self->lazy) {
+        if (self->is_finalizing) {
+            // Smoothing only needs the neighbouring terrain. Keep these out of the cache, which only holds finished columns.
+            generate_column(mutable_self, pos[AXIS__X], pos[AXIS__Z]);
+            return chunk_map_get(self->chunks, pos);
+        }
+        finalize_column(mutable_self, pos[AXIS__X], pos[AXIS__Z]);
+    }
+
+    chunk_t* const chunk = chunk_map_get(self->chunks, pos);
+    assert(chunk != nullptr);
+
+    memcpy(entry->pos, pos, sizeof(pos_chunks_t) * NUM_AXES);
+    entry->chunk = chunk;
+
+    return chunk;
+}
+
+tile_t const level_get_tile(level_t const* const self, pos_tiles_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+    assert(!level_is_tile_oob(self, pos));
+
     chunk_t* const chunk = level_get_chunk(self, TO_CHUNK_SPACE_ARR(pos));
 
     return chunk_get_tile(chunk, TO_POS_IN_CHUNK_ARR(pos));
 }
 
-void level_set_tile(level_t* const self, size_t const pos[NUM_AXES], tile_t const tile) {
+void level_set_tile(level_t* const self, pos_tiles_t const pos[NUM_AXES], tile_t const tile) {
     assert(self != nullptr);
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        assert(pos[a] >= 0 && pos[a] < TO_TILE_SPACE(self->size[a]));
-    }
+    assert(!level_is_tile_oob(self, pos));
+
     chunk_t* const chunk = level_get_chunk(self, TO_CHUNK_SPACE_ARR(pos));
 
     chunk_set_tile(chunk, TO_POS_IN_CHUNK_ARR(pos), tile);
 
-    self->is_chunk_dirty[CHUNK_INDEX(TO_CHUNK_SPACE_ARR(pos))] = true;
+    update_surface_height(self, pos[AXIS__X], pos[AXIS__Z], pos[AXIS__Y] + 1);
+    mark_tile_changed(self, pos);
 }
 
-tile_shape_t const level_get_tile_shape(level_t const* const self, size_t const pos[NUM_AXES]) {
+void level_set_tile_smoothed(level_t* const self, pos_tiles_t const pos[NUM_AXES], tile_t const tile) {
     assert(self != nullptr);
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        assert(pos[a] >= 0 && pos[a] < TO_TILE_SPACE(self->size[a]));
-    }
+
+    level_set_tile(self, pos, tile);
+    level_gen_reshape_around(self->level_gen, self, pos);
+}
+
+tile_shape_t const level_get_tile_shape(level_t const* const self, pos_tiles_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+    assert(!level_is_tile_oob(self, pos));
 
     chunk_t* const chunk = level_get_chunk(self, TO_CHUNK_SPACE_ARR(pos));
 
     return chunk_get_tile_shape(chunk, TO_POS_IN_CHUNK_ARR(pos));
 }
 
-void level_set_tile_shape(level_t* const self, size_t const pos[NUM_AXES], tile_shape_t const shape) {
+void level_set_tile_shape(level_t* const self, pos_tiles_t const pos[NUM_AXES], tile_shape_t const shape) {
     assert(self != nullptr);
-    for (axis_t a = 0; a < NUM_AXES; a++) {
-        assert(pos[a] >= 0 && pos[a] < TO_TILE_SPACE(self->size[a]));
-    }
+    assert(!level_is_tile_oob(self, pos));
 
     chunk_t* const chunk = level_get_chunk(self, TO_CHUNK_SPACE_ARR(pos));
 
     chunk_set_tile_shape(chunk, TO_POS_IN_CHUNK_ARR(pos), shape);
 
-    self->is_chunk_dirty[CHUNK_INDEX(TO_CHUNK_SPACE_ARR(pos))] = true;
+    mark_tile_changed(self, pos);
+}
+
+void level_read_region(level_t const* const self, pos_tiles_t const min[NUM_AXES], pos_tiles_t const max[NUM_AXES], tile_t* const tiles, tile_shape_t* const shapes) {
+    assert(self != nullptr);
+    for (axis_t a = 0; a < NUM_AXES; a++) {
+        assert(min[a] <= max[a]);
+    }
+
+    size_t const strides[NUM_AXES] = {
+        [AXIS__X] = 1,
+        [AXIS__Y] = (size_t) ((max[AXIS__X] - min[AXIS__X]) * (max[AXIS__Z] - min[AXIS__Z])),
+        [AXIS__Z] = (size_t) (max[AXIS__X] - min[AXIS__X])
+    };
+
+    for (pos_chunks_t y = TO_CHUNK_SPACE(min[AXIS__Y]); y <= TO_CHUNK_SPACE(max[AXIS__Y] - 1); y++) {
+        for (pos_chunks_t z = TO_CHUNK_SPACE(min[AXIS__Z]); z <= TO_CHUNK_SPACE(max[AXIS__Z] - 1); z++) {
+            for (pos_chunks_t x = TO_CHUNK_SPACE(min[AXIS__X]); x <= TO_CHUNK_SPACE(max[AXIS__X] - 1); x++) {
+                pos_chunks_t const chunk_pos[NUM_AXES] = { x, y, z };
+                size_t local_min[NUM_AXES];
+                size_t local_max[NUM_AXES];
+                size_t offset;
+                if (!clip_region_to_chunk(min, max, strides, chunk_pos, local_min, local_max, &offset)) {
+                    continue;
+                }
+
+                if (!is_chunk_oob(self, chunk_pos)) {
+                    chunk_t const* const chunk = level_get_chunk(self, chunk_pos);
+                    chunk_read_region(chunk, local_min, local_max, strides, tiles != nullptr ? tiles + offset : nullptr, shapes != nullptr ? shapes + offset : nullptr);
+                    continue;
+                }
+
+                for (size_t ly = 0; ly < local_max[AXIS__Y] - local_min[AXIS__Y]; ly++) {
+                    for (size_t lz = 0; lz < local_max[AXIS__Z] - local_min[AXIS__Z]; lz++) {
+                        size_t const row = offset + (ly * strides[AXIS__Y]) + (lz * strides[AXIS__Z]);
+                        for (size_t lx = 0; lx < local_max[AXIS__X] - local_min[AXIS__X]; lx++) {
+                            if (tiles != nullptr) {
+                                tiles[row + lx] = TILE__AIR;
+                            }
+                            if (shapes != nullptr) {
+                                shapes[row + lx] = TILE_SHAPE__NO_RENDER;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void level_write_region(level_t* const self, pos_tiles_t const min[NUM_AXES], pos_tiles_t const max[NUM_AXES], tile_t const* const tiles, tile_shape_t const* const shapes) {
+    assert(self != nullptr);
+    assert(tiles != nullptr || shapes != nullptr);
+    for (axis_t a = 0; a < NUM_AXES; a++) {
+        assert(min[a] <= max[a]);
+    }
+
+    size_t const strides[NUM_AXES] = {
+        [AXIS__X] = 1,
+        [AXIS__Y] = (size_t) ((max[AXIS__X] - min[AXIS__X]) * (max[AXIS__Z] - min[AXIS__Z])),
+        [AXIS__Z] = (size_t) (max[AXIS__X] - min[AXIS__X])
+    };
+
+    for (pos_chunks_t y = TO_CHUNK_SPACE(min[AXIS__Y]); y <= TO_CHUNK_SPACE(max[AXIS__Y] - 1); y++) {
+        for (pos_chunks_t z = TO_CHUNK_SPACE(min[AXIS__Z]); z <= TO_CHUNK_SPACE(max[AXIS__Z] - 1); z++) {
+            for (pos_chunks_t x = TO_CHUNK_SPACE(min[AXIS__X]); x <= TO_CHUNK_SPACE(max[AXIS__X] - 1); x++) {
+                pos_chunks_t const chunk_pos[NUM_AXES] = { x, y, z };
+                size_t local_min[NUM_AXES];
+                size_t local_max[NUM_AXES];
+                size_t offset;
+                if (!clip_region_to_chunk(min, max, strides, chunk_pos, local_min, local_max, &offset)) {
+                    continue;
+                }
+                assert(!is_chunk_oob(self, chunk_pos));
+
+                chunk_t* const chunk = level_get_chunk(self, chunk_pos);
+                chunk_write_region(chunk, local_min, local_max, strides, tiles != nullptr ? tiles + offset : nullptr, shapes != nullptr ? shapes + offset : nullptr);
+
+                mark_chunk_changed(self, chunk_pos, local_min, local_max);
+            }
+        }
+    }
+
+    if (tiles != nullptr) {
+        for (pos_tiles_t z = min[AXIS__Z]; z < max[AXIS__Z]; z++) {
+            for (pos_tiles_t x = min[AXIS__X]; x < max[AXIS__X]; x++) {
+                update_surface_height(self, x, z, max[AXIS__Y]);
+            }
+        }
+    }
+}
+
+size_t const level_get_surface_height(level_t const* const self, pos_tiles_t const x, pos_tiles_t const z) {
+    assert(self != nullptr);
+    assert(!level_is_tile_oob(self, (pos_tiles_t[NUM_AXES]) { x, 0, z }));
+
+    // Makes sure the column exists, and in a lazy level that it is finalized.
+    level_get_chunk(self, COLUMN_KEY_ARR(TO_CHUNK_SPACE(x), TO_CHUNK_SPACE(z)));
+
+    column_t const* const column = chunk_map_get(self->columns, COLUMN_KEY_ARR(TO_CHUNK_SPACE(x), TO_CHUNK_SPACE(z)));
+    assert(column != nullptr);
+
+    return column->surface_heights[(CHUNK_LOCAL(z) * CHUNK_SIZE) + CHUNK_LOCAL(x)];
+}
+
+void level_get_surface_heights(level_t const* const self, pos_chunks_t const x, pos_chunks_t const z, uint32_t heights[CHUNK_SIZE * CHUNK_SIZE]) {
+    assert(self != nullptr);
+    assert(heights != nullptr);
+
+    // Makes sure the column exists, and in a lazy level that it is finalized.
+    level_get_chunk(self, COLUMN_KEY_ARR(x, z));
+
+    column_t const* const column = chunk_map_get(self->columns, COLUMN_KEY_ARR(x, z));
+    assert(column != nullptr);
+
+    memcpy(heights, column->surface_heights, sizeof(column->surface_heights));
+}
+
+void level_cursor_init(level_cursor_t* const self, level_t const* const level, pos_tiles_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+    assert(level != nullptr);
+
+    self->level = level;
+    memcpy(self->pos, pos, sizeof(pos_tiles_t) * NUM_AXES);
+    memcpy(self->pos_in_chunk, TO_POS_IN_CHUNK_ARR(pos), sizeof(size_t) * NUM_AXES);
+    self->chunk = level_is_tile_oob(level, pos) ? nullptr : level_get_chunk(level, TO_CHUNK_SPACE_ARR(pos));
+}
+
+void level_cursor_move(level_cursor_t* const self, side_t const side) {
+    assert(self != nullptr);
+    assert(side >= 0 && side < NUM_SIDES);
+
+    int offsets[NUM_AXES];
+    side_get_offsets(side, offsets);
+
+    level_cursor_move_by(self, offsets);
+}
+
+void level_cursor_move_by(level_cursor_t* const self, int const offsets[NUM_AXES]) {
+    assert(self != nullptr);
+
+    bool crossed = false;
+    for (axis_t a = 0; a < NUM_AXES; a++) {
+        self->pos[a] += offsets[a];
+        ptrdiff_t const pos_in_chunk = SIGNED(self->pos_in_chunk[a]) + offsets[a];
+        if (pos_in_chunk < 0 || pos_in_chunk >= CHUNK_SIZE) {
+            crossed = true;
+        }
+        self->pos_in_chunk[a] = CHUNK_LOCAL(self->pos[a]);
+    }
+
+    if (crossed || self->chunk == nullptr) {
+        self->chunk = level_is_tile_oob(self->level, self->pos) ? nullptr : level_get_chunk(self->level, TO_CHUNK_SPACE_ARR(self->pos));
+    }
+}
+
+bool const level_cursor_is_oob(level_cursor_t const* const self) {
+    assert(self != nullptr);
+
+    return self->chunk == nullptr;
+}
+
+tile_t const level_cursor_get_tile(level_cursor_t const* const self) {
+    assert(self != nullptr);
+    assert(self->chunk != nullptr);
+
+    return chunk_get_tile(self->chunk, self->pos_in_chunk);
+}
+
+tile_shape_t const level_cursor_get_tile_shape(level_cursor_t const* const self) {
+    assert(self != nullptr);
+    assert(self->chunk != nullptr);
+
+    return chunk_get_tile_shape(self->chunk, self->pos_in_chunk);
 }
 
 void level_tick(level_t* const self) {
     assert(self != nullptr);
 
+    if (self->lazy) {
+        generate_near_observers(self, LAZY_COLUMNS_PER_TICK);
+    }
+
     ecs_tick(self->ecs, self);
 
-    for (size_chunks_t x = 0; x < self->size[AXIS__X]; x++) {
-        for (size_chunks_t y = 0; y < self->size[AXIS__Y]; y++) {
-            for (size_chunks_t z = 0; z < self->size[AXIS__Z]; z++) {
-                size_chunks_t const i_pos[NUM_AXES] = { x, y, z };
-                self->is_chunk_dirty[CHUNK_INDEX(i_pos)] = false;
-            }
+    if (self->saver != nullptr) {
+        level_saver_collect(self->saver);
+    }
+}
+
+level_observer_t const level_add_observer(level_t* const self, float const pos[NUM_AXES], size_chunks_t const radius) {
+    assert(self != nullptr);
+
+    bool found_slot = false;
+    level_observer_t observer = 0;
+    for (level_observer_t i = 0; i < MAX_LEVEL_OBSERVERS; i++) {
+        if (!self->observers[i].active) {
+            observer = i;
+            found_slot = true;
+            break;
         }
     }
+    assert(found_slot);
+
+    self->observers[observer].active = true;
+    memcpy(self->observers[observer].pos, pos, sizeof(float) * NUM_AXES);
+    self->observers[observer].radius = radius;
+
+    return observer;
+}
+
+void level_move_observer(level_t* const self, level_observer_t const observer, float const pos[NUM_AXES]) {
+    assert(self != nullptr);
+    assert(observer < MAX_LEVEL_OBSERVERS);
+    assert(self->observers[observer].active);
+
+    memcpy(self->observers[observer].pos, pos, sizeof(float) * NUM_AXES);
+}
+
+void level_remove_observer(level_t* const self, level_observer_t const observer) {
+    assert(self != nullptr);
+    assert(observer < MAX_LEVEL_OBSERVERS);
+    assert(self->observers[observer].active);
+
+    self->observers[observer].active = false;
 }
 
 ecs_t* const level_get_ecs(level_t* const self) {
@@ -313,20 +843,20 @@ float const level_get_nearest_face_on_axis(level_t const* const self, float cons
     int o[NUM_AXES];
     side_get_offsets(side, o);
 
-    size_chunks_t level_size[NUM_AXES];
-    level_get_size(self, level_size);
-
     float i_pos[NUM_AXES];
     for (axis_t a = 0; a < NUM_AXES; a++) {
-        i_pos[a] = (int) pos[a] + 0.5f;
+        i_pos[a] = floorf(pos[a]) + 0.5f;
     }
 
     for (axis_t a = 0; a < NUM_AXES; a++) {
         if (o[a] != 0) {
             float d = i_pos[a] - pos[a];
 
+            level_cursor_t cursor;
+            level_cursor_init(&cursor, self, TO_TILE_POS_ARR(i_pos));
+
             while (true) {
-                if (i_pos[a] < 0.0f || i_pos[a] >= level_size[a] * CHUNK_SIZE) {
+                if (is_coord_oob(self, a, (ptrdiff_t) floorf(i_pos[a]), CHUNK_SIZE)) {
                     if (o[a] < 0) {
                         return ceil(i_pos[a]);
                     } else {
@@ -335,12 +865,22 @@ float const level_get_nearest_face_on_axis(level_t const* const self, float cons
                 }
 
                 for (axis_t aa = 0; aa < NUM_AXES; aa++) {
-                    if (i_pos[aa] < 0.0f || i_pos[aa] >= level_size[aa] * CHUNK_SIZE) {
+                    if (is_coord_oob(self, aa, (ptrdiff_t) floorf(i_pos[aa]), CHUNK_SIZE)) {
                         return NAN;
                     }
                 }
-                tile_t const tile = level_get_tile(self, VEC_CAST(size_t, i_pos));
-                if (tile != TILE__AIR) {
+                // Skip straight to the far edge of an empty chunk; every tile before it is air.
+                // Only the moving axis changes, so the cursor is stepped by the difference along it.
+                int step[NUM_AXES] = { 0, 0, 0 };
+                step[a] = (int) (TO_TILE_POS_ARR(i_pos)[a] - cursor.pos[a]);
+                level_cursor_move_by(&cursor, step);
+
+                if (max_range >= 0.5f && chunk_is_empty(cursor.chunk)) {
+                    size_t const in_chunk = cursor.pos_in_chunk[a];
+                    size_t const skip = o[a] > 0 ? (CHUNK_SIZE - 1) - in_chunk : in_chunk;
+                    d += o[a] * (float) skip;
+                    i_pos[a] += o[a] * (float) skip;
+                } else if ((chunk_get_occupancy(cursor.chunk)[CHUNK_ROW(cursor.pos_in_chunk[AXIS__Y], cursor.pos_in_chunk[AXIS__Z])] >> cursor.pos_in_chunk[AXIS__X]) & 1) {
                     break;
                 }
 
@@ -395,3 +935,708 @@ float const level_get_nearest_face_on_axis(level_t const* const self, float cons
 
     return NAN;
 }
+
+static bool const is_coord_oob(level_t const* const self, axis_t const axis, ptrdiff_t const coord, ptrdiff_t const scale) {
+    assert(self != nullptr);
+
+    // A size of 0 leaves the axis unbounded.
+    return self->size[axis] != 0 && (coord < 0 || coord >= SIGNED(self->size[axis]) * scale);
+}
+
+static bool const is_chunk_oob(level_t const* const self, pos_chunks_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+
+    return
+        is_coord_oob(self, AXIS__X, pos[AXIS__X], 1) ||
+        is_coord_oob(self, AXIS__Y, pos[AXIS__Y], 1) ||
+        is_coord_oob(self, AXIS__Z, pos[AXIS__Z], 1);
+}
+
+static column_t* const generate_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z) {
+    assert(self != nullptr);
+
+    column_t* column = chunk_map_get(self->columns, COLUMN_KEY_ARR(x, z));
+    if (column != nullptr) {
+        return column;
+    }
+
+    column = load_column(self, x, z);
+    if (column != nullptr) {
+        return column;
+    }
+
+    level_gen_column_t shape;
+    level_gen_shape_column(self->level_gen, x, z, &shape);
+
+    for (pos_chunks_t y = 0; y < (pos_chunks_t) self->size[AXIS__Y]; y++) {
+        chunk_t* const chunk = chunk_new((pos_chunks_t[NUM_AXES]) { x, y, z });
+        level_gen_generate(self->level_gen, &shape, chunk, nullptr);
+        chunk_map_put(self->chunks, (pos_chunks_t[NUM_AXES]) { x, y, z }, chunk);
+    }
+
+    return add_column(self, x, z, COLUMN_STATE__GENERATED);
+}
+
+static void generate_column_task(void* const arg, size_t const index) {
+    level_gen_job_t* const job = arg;
+    chunk_t* const* const chunks = &(job->chunks[index * job->height]);
+
+    pos_chunks_t chunk_pos[NUM_AXES];
+    chunk_get_pos(chunks[0], chunk_pos);
+
+    uint64_t const start_time = get_time_ns();
+    level_gen_column_t shape;
+    level_gen_shape_column(job->level_gen, chunk_pos[AXIS__X], chunk_pos[AXIS__Z], &shape);
+    uint64_t const shaped_time = get_time_ns();
+
+    // Caves are sampled per chunk while filling, so their noise is taken out of the fill time.
+    uint64_t cave_ns = 0;
+    for (size_chunks_t y = 0; y < job->height; y++) {
+        level_gen_generate(job->level_gen, &shape, chunks[y], &cave_ns);
+    }
+    uint64_t const filled_time = get_time_ns();
+
+    atomic_fetch_add_explicit(&(job->noise_ns), (shaped_time - start_time) + cave_ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&(job->fill_ns), (filled_time - shaped_time) - cave_ns, memory_order_relaxed);
+}
+
+// Expects every chunk of the column to be in place already.
+static column_t* const add_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z, column_state_t const state) {
+    assert(self != nullptr);
+
+    column_t* const column = calloc(1, sizeof(column_t) + sizeof(uint64_t) * self->size[AXIS__Y]);
+    assert(column != nullptr);
+
+    column->state = state;
+    compute_surface_heights(self, column, x, z);
+    chunk_map_put(self->columns, COLUMN_KEY_ARR(x, z), column);
+
+    return column;
+}
+
+static column_t* const load_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z) {
+    assert(self != nullptr);
+
+    region_file_t const* const region = get_region(self, REGION_COORD(x), REGION_COORD(z));
+    if (region == nullptr) {
+        return nullptr;
+    }
+
+    size_t const local_x = (size_t) (x - (REGION_COORD(x) * REGION_SIZE));
+    size_t const local_z = (size_t) (z - (REGION_COORD(z) * REGION_SIZE));
+
+    // Columns are always saved whole, so the first chunk tells whether the region holds this one.
+    size_t size;
+    if (region_file_get_chunk(region, (size_t[NUM_AXES]) { local_x, 0, local_z }, &size) == nullptr) {
+        return nullptr;
+    }
+
+    for (pos_chunks_t y = 0; y < (pos_chunks_t) self->size[AXIS__Y]; y++) {
+        uint8_t const* const data = region_file_get_chunk(region, (size_t[NUM_AXES]) { local_x, (size_t) y, local_z }, &size);
+        chunk_t* const chunk = data != nullptr ? chunk_deserialize(size, data) : nullptr;
+
+        pos_chunks_t chunk_pos[NUM_AXES];
+        if (chunk != nullptr) {
+            chunk_get_pos(chunk, chunk_pos);
+        }
+        if (chunk == nullptr || chunk_pos[AXIS__X] != x || chunk_pos[AXIS__Y] != y || chunk_pos[AXIS__Z] != z) {
+            LOG_ERROR("level_t: saved column [%d, %d] is corrupt, regenerating it.", x, z);
+            if (chunk != nullptr) {
+                chunk_delete(chunk);
+            }
+            for (pos_chunks_t i = 0; i < y; i++) {
+                chunk_delete(chunk_map_remove(self->chunks, (pos_chunks_t[NUM_AXES]) { x, i, z }));
+            }
+            return nullptr;
+        }
+
+        chunk_map_put(self->chunks, (pos_chunks_t[NUM_AXES]) { x, y, z }, chunk);
+    }
+
+    column_t* const column = add_column(self, x, z, COLUMN_STATE__FINALIZED);
+    column->is_on_disk = true;
+    column->saved_generation = self->generation;
+
+    return column;
+}
+
+static region_file_t* const get_region(level_t* const self, pos_chunks_t const x, pos_chunks_t const z) {
+    assert(self != nullptr);
+
+    if (self->path == nullptr) {
+        return nullptr;
+    }
+
+    region_file_t* region = chunk_map_get(self->regions, COLUMN_KEY_ARR(x, z));
+    if (region != nullptr) {
+        return region;
+    }
+
+    // Missing regions are not remembered; a later save may create them.
+    char* const path = get_region_path(self->path, x, z);
+    region = region_file_open(path);
+    if (region != nullptr && region_file_get_height(region) != self->size[AXIS__Y]) {
+        LOG_ERROR("level_t: region %s has a different height to the level, ignoring it.", path);
+        region_file_close(region);
+        region = nullptr;
+    }
+    free(path);
+
+    if (region != nullptr) {
+        chunk_map_put(self->regions, COLUMN_KEY_ARR(x, z), region);
+    }
+
+    return region;
+}
+
+static char* const get_region_path(char const* const dir, pos_chunks_t const x, pos_chunks_t const z) {
+    assert(dir != nullptr);
+
+    size_t const length = strlen(dir) + 64;
+    char* const path = malloc(length);
+    assert(path != nullptr);
+
+    snprintf(path, length, "%s/r.%d.%d.bin", dir, x, z);
+
+    return path;
+}
+
+static void mark_column_unsaved(level_t* const self, column_t* const column, pos_chunks_t const x, pos_chunks_t const z) {
+    assert(self != nullptr);
+    assert(column != nullptr);
+
+    if (!column->needs_save) {
+        column->needs_save = true;
+        chunk_map_put(self->unsaved_columns, COLUMN_KEY_ARR(x, z), column);
+    }
+}
+
+static bool const write_level_dat(level_t const* const self, char const* const path) {
+    assert(self != nullptr);
+    assert(path != nullptr);
+
+    char* const dat_path = strcata(path, LEVEL_DAT_NAME);
+    FILE* const file = fopen(dat_path, "w");
+    if (file == nullptr) {
+        LOG_ERROR("level_t: failed to open %s for writing.", dat_path);
+        free(dat_path);
+        return false;
+    }
+
+    fprintf(file, "version %d\n", LEVEL_DAT_VERSION);
+    fprintf(file, "seed %" PRIu64 "\n", self->seed);
+    fprintf(file, "size %zu %zu %zu\n", self->size[AXIS__X], self->size[AXIS__Y], self->size[AXIS__Z]);
+
+    bool const ok = fclose(file) == 0;
+    if (!ok) {
+        LOG_ERROR("level_t: failed to write %s.", dat_path);
+    }
+    free(dat_path);
+
+    return ok;
+}
+
+static bool const read_level_dat(char const* const path, level_settings_t* const settings) {
+    assert(path != nullptr);
+    assert(settings != nullptr);
+
+    char* const dat_path = strcata(path, LEVEL_DAT_NAME);
+    FILE* const file = fopen(dat_path, "r");
+    if (file == nullptr) {
+        free(dat_path);
+        return false;
+    }
+
+    int version = 0;
+    bool const ok =
+        fscanf(file, " version %d", &version) == 1 && version == LEVEL_DAT_VERSION &&
+        fscanf(file, " seed %" SCNu64, &(settings->seed)) == 1 &&
+        fscanf(file, " size %zu %zu %zu", &(settings->size[AXIS__X]), &(settings->size[AXIS__Y]), &(settings->size[AXIS__Z])) == 3 &&
+        settings->size[AXIS__Y] > 0;
+    fclose(file);
+
+    if (!ok) {
+        LOG_ERROR("level_t: %s is not a valid level description.", dat_path);
+    }
+    free(dat_path);
+
+    return ok;
+}
+
+static void finalize_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z) {
+    assert(self != nullptr);
+
+    column_t* const column = generate_column(self, x, z);
+    if (column->state == COLUMN_STATE__FINALIZED) {
+        return;
+    }
+
+    // Smoothing looks one tile past the column edges, so the surrounding columns need terrain first.
+    for (pos_chunks_t dz = -1; dz <= 1; dz++) {
+        for (pos_chunks_t dx = -1; dx <= 1; dx++) {
+            if (!is_coord_oob(self, AXIS__X, x + dx, 1) && !is_coord_oob(self, AXIS__Z, z + dz, 1)) {
+                generate_column(self, x + dx, z + dz);
+            }
+        }
+    }
+
+    self->is_finalizing = true;
+    level_gen_smooth_region(self->level_gen, self, nullptr, TO_TILE_SPACE(x), TO_TILE_SPACE(z), TO_TILE_SPACE(x) + CHUNK_SIZE, TO_TILE_SPACE(z) + CHUNK_SIZE);
+    self->is_finalizing = false;
+
+    column->state = COLUMN_STATE__FINALIZED;
+    mark_column_unsaved(self, column, x, z);
+
+    populate_column(self, x, z);
+}
+
+static void populate_column(level_t* const self, pos_chunks_t const x, pos_chunks_t const z) {
+    assert(self != nullptr);
+
+    column_t const* const column = chunk_map_get(self->columns, COLUMN_KEY_ARR(x, z));
+    assert(column != nullptr);
+
+    chunk_t** const chunks = malloc(sizeof(chunk_t*) * self->size[AXIS__Y]);
+    assert(chunks != nullptr);
+    for (pos_chunks_t y = 0; y < (pos_chunks_t) self->size[AXIS__Y]; y++) {
+        chunks[y] = level_get_chunk(self, (pos_chunks_t[NUM_AXES]) { x, y, z });
+    }
+
+    decoration_t decoration;
+    plan_decoration(self, x, z, column, chunks, &decoration);
+    add_decoration(self, &decoration);
+
+    free(decoration.features);
+    free(chunks);
+}
+
+static void bump_chunk_generation(level_t* const self, pos_chunks_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+
+    if (is_chunk_oob(self, pos)) {
+        return;
+    }
+    // Nothing can hold a stale copy of a chunk that has not been generated yet.
+    column_t* const column = chunk_map_get(self->columns, COLUMN_KEY_ARR(pos[AXIS__X], pos[AXIS__Z]));
+    if (column == nullptr) {
+        return;
+    }
+
+    self->generation++;
+    column->chunk_generations[pos[AXIS__Y]] = self->generation;
+    mark_column_unsaved(self, column, pos[AXIS__X], pos[AXIS__Z]);
+
+    // Runs of edits to one chunk share a single entry, which just moves to the newest generation.
+    if (self->journal_length > 0) {
+        level_change_t* const last = &(self->journal[(self->journal_length - 1) % LEVEL_JOURNAL_SIZE]);
+        if (memcmp(last->pos, pos, sizeof(pos_chunks_t) * NUM_AXES) == 0) {
+            last->generation = self->generation;
+            return;
+        }
+    }
+
+    level_change_t* const entry = &(self->journal[self->journal_length % LEVEL_JOURNAL_SIZE]);
+    if (self->journal_length >= LEVEL_JOURNAL_SIZE) {
+        self->journal_evicted_generation = entry->generation;
+    }
+    memcpy(entry->pos, pos, sizeof(pos_chunks_t) * NUM_AXES);
+    entry->generation = self->generation;
+    self->journal_length++;
+}
+
+static void mark_chunk_changed(level_t* const self, pos_chunks_t const pos[NUM_AXES], size_t const local_min[NUM_AXES], size_t const local_max[NUM_AXES]) {
+    assert(self != nullptr);
+
+    bump_chunk_generation(self, pos);
+
+    // Neighbours sharing a touched face have to re-evaluate their own faces against it.
+    for (axis_t a = 0; a < NUM_AXES; a++) {
+        pos_chunks_t neighbour[NUM_AXES] = { pos[AXIS__X], pos[AXIS__Y], pos[AXIS__Z] };
+        if (local_min[a] == 0) {
+            neighbour[a] = pos[a] - 1;
+            bump_chunk_generation(self, neighbour);
+        }
+        if (local_max[a] == CHUNK_SIZE) {
+            neighbour[a] = pos[a] + 1;
+            bump_chunk_generation(self, neighbour);
+        }
+    }
+}
+
+static void mark_tile_changed(level_t* const self, pos_tiles_t const pos[NUM_AXES]) {
+    assert(self != nullptr);
+
+    pos_chunks_t const chunk_pos[NUM_AXES] = { TO_CHUNK_SPACE(pos[AXIS__X]), TO_CHUNK_SPACE(pos[AXIS__Y]), TO_CHUNK_SPACE(pos[AXIS__Z]) };
+    size_t const* const local_min = TO_POS_IN_CHUNK_ARR(pos);
+    size_t const local_max[NUM_AXES] = { local_min[AXIS__X] + 1, local_min[AXIS__Y] + 1, local_min[AXIS__Z] + 1 };
+
+    mark_chunk_changed(self, chunk_pos, local_min, local_max);
+}
+
+static void compute_surface_heights(level_t const* const self, column_t* const column, pos_chunks_t const x, pos_chunks_t const z) {
+    assert(self != nullptr);
+    assert(column != nullptr);
+
+    // Scan down from the top, skipping empty chunks, until every tile column has found its surface.
+    memset(column->surface_heights, 0, sizeof(column->surface_heights));
+    size_t remaining = CHUNK_SIZE * CHUNK_SIZE;
+    for (size_t y = self->size[AXIS__Y]; y > 0 && remaining > 0; y--) {
+        chunk_t const* const chunk = chunk_map_get(self->chunks, (pos_chunks_t[NUM_AXES]) { x, (pos_chunks_t) (y - 1), z });
+        assert(chunk != nullptr);
+        if (chunk_is_empty(chunk)) {
+            continue;
+        }
+
+        for (size_t lz = 0; lz < CHUNK_SIZE; lz++) {
+            for (size_t lx = 0; lx < CHUNK_SIZE; lx++) {
+                uint32_t* const height = &(column->surface_heights[(lz * CHUNK_SIZE) + lx]);
+                if (*height != 0) {
+                    continue;
+                }
+                for (size_t ly = CHUNK_SIZE; ly > 0; ly--) {
+                    if (chunk_get_tile(chunk, (size_t[NUM_AXES]) { lx, ly - 1, lz }) != TILE__AIR) {
+                        *height = (uint32_t) (((y - 1) * CHUNK_SIZE) + ly);
+                        remaining--;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void update_surface_height(level_t* const self, pos_tiles_t const x, pos_tiles_t const z, pos_tiles_t const top) {
+    assert(self != nullptr);
+
+    column_t* const column = chunk_map_get(self->columns, COLUMN_KEY_ARR(TO_CHUNK_SPACE(x), TO_CHUNK_SPACE(z)));
+    assert(column != nullptr);
+
+    // Only tiles below top changed, so a surface above them still stands.
+    uint32_t* const height = &(column->surface_heights[(CHUNK_LOCAL(z) * CHUNK_SIZE) + CHUNK_LOCAL(x)]);
+    if (SIGNED(*height) > top) {
+        return;
+    }
+
+    level_cursor_t cursor;
+    level_cursor_init(&cursor, self, (pos_tiles_t[NUM_AXES]) { x, top - 1, z });
+    while (!level_cursor_is_oob(&cursor) && level_cursor_get_tile(&cursor) == TILE__AIR) {
+        level_cursor_move(&cursor, SIDE__BOTTOM);
+    }
+    *height = level_cursor_is_oob(&cursor) ? 0 : (uint32_t) (cursor.pos[AXIS__Y] + 1);
+}
+
+static bool const clip_region_to_chunk(pos_tiles_t const min[NUM_AXES], pos_tiles_t const max[NUM_AXES], size_t const strides[NUM_AXES], pos_chunks_t const chunk_pos[NUM_AXES], size_t local_min[NUM_AXES], size_t local_max[NUM_AXES], size_t* const offset) {
+    *offset = 0;
+    for (axis_t a = 0; a < NUM_AXES; a++) {
+        pos_tiles_t const origin = TO_TILE_SPACE(chunk_pos[a]);
+        pos_tiles_t const lo = MAX(min[a], origin);
+        pos_tiles_t const hi = MIN(max[a], origin + CHUNK_SIZE);
+        if (lo >= hi) {
+            return false;
+        }
+        local_min[a] = (size_t) (lo - origin);
+        local_max[a] = (size_t) (hi - origin);
+        *offset += (size_t) (lo - min[a]) * strides[a];
+    }
+
+    return true;
+}
+
+static void generate_near_observers(level_t* const self, size_t const budget) {
+    assert(self != nullptr);
+
+    for (size_t n = 0; n < budget; n++) {
+        bool found = false;
+        pos_chunks_t best_x = 0;
+        pos_chunks_t best_z = 0;
+        long best_distance = 0;
+
+        for (level_observer_t i = 0; i < MAX_LEVEL_OBSERVERS; i++) {
+            observer_t const* const observer = &(self->observers[i]);
+            if (!observer->active) {
+                continue;
+            }
+
+            pos_chunks_t const center_x = (pos_chunks_t) floorf(observer->pos[AXIS__X] / CHUNK_SIZE);
+            pos_chunks_t const center_z = (pos_chunks_t) floorf(observer->pos[AXIS__Z] / CHUNK_SIZE);
+            pos_chunks_t const radius = (pos_chunks_t) observer->radius;
+
+            for (pos_chunks_t z = center_z - radius; z <= center_z + radius; z++) {
+                for (pos_chunks_t x = center_x - radius; x <= center_x + radius; x++) {
+                    if (is_coord_oob(self, AXIS__X, x, 1) || is_coord_oob(self, AXIS__Z, z, 1)) {
+                        continue;
+                    }
+                    column_t const* const column = chunk_map_get(self->columns, COLUMN_KEY_ARR(x, z));
+                    if (column != nullptr && column->state == COLUMN_STATE__FINALIZED) {
+                        continue;
+                    }
+                    long const distance = ((long) (x - center_x) * (x - center_x)) + ((long) (z - center_z) * (z - center_z));
+                    if (!found || distance < best_distance) {
+                        found = true;
+                        best_x = x;
+                        best_z = z;
+                        best_distance = distance;
+                    }
+                }
+            }
+        }
+
+        if (!found) {
+            return;
+        }
+
+        finalize_column(self, best_x, best_z);
+    }
+}
+
+static uint64_t const get_column_seed(level_t const* const self, pos_chunks_t const x, pos_chunks_t const z) {
+    assert(self != nullptr);
+
+    // Large odd multipliers keep neighbouring columns' seeds far apart.
+    return self->seed ^ ((uint64_t) (int64_t) x * 341873128712ULL) ^ ((uint64_t) (int64_t) z * 132897987541ULL);
+}
+
+static void plan_decoration(level_t const* const self, pos_chunks_t const x, pos_chunks_t const z, column_t const* const column, chunk_t* const* const chunks, decoration_t* const decoration) {
+    assert(self != nullptr);
+    assert(column != nullptr);
+    assert(chunks != nullptr);
+    assert(decoration != nullptr);
+
+    random_t* const rand = random_new(get_column_seed(self, x, z));
+
+    // Spread the level-wide counts evenly, rounding the remainder up at random so the totals match on average.
+    uint32_t const num_columns = (self->size[AXIS__X] != 0 && self->size[AXIS__Z] != 0) ? self->size[AXIS__X] * self->size[AXIS__Z] : DECORATION_REFERENCE_COLUMNS;
+    size_t const num_trees = (NUM_TREES / num_columns) + (random_next_int_bounded(rand, num_columns) < (NUM_TREES % num_columns) ? 1 : 0);
+    size_t const num_mobs = (NUM_MOBS / num_columns) + (random_next_int_bounded(rand, num_columns) < (NUM_MOBS % num_columns) ? 1 : 0);
+
+    decoration->num_features = 0;
+    decoration->features = nullptr;
+    if (num_trees + num_mobs > 0) {
+        decoration->features = malloc(sizeof(feature_t) * (num_trees + num_mobs));
+        assert(decoration->features != nullptr);
+    }
+
+    size_t placed = 0;
+    for (size_t attempt = 0; placed < num_trees && attempt < num_trees * MAX_TREE_ATTEMPTS; attempt++) {
+        size_t const lx = random_next_int_bounded(rand, CHUNK_SIZE);
+        size_t const lz = random_next_int_bounded(rand, CHUNK_SIZE);
+        feature_t* const feature = &(decoration->features[decoration->num_features]);
+        if (plan_tree(x, z, column, chunks, lx, lz, feature->pos)) {
+            feature->type = FEATURE_TYPE__TREE;
+            decoration->num_features++;
+            placed++;
+        }
+    }
+
+    for (size_t i = 0; i < num_mobs; i++) {
+        size_t const lx = random_next_int_bounded(rand, CHUNK_SIZE);
+        size_t const lz = random_next_int_bounded(rand, CHUNK_SIZE);
+        feature_t* const feature = &(decoration->features[decoration->num_features++]);
+        feature->type = FEATURE_TYPE__MOB;
+        feature->pos[AXIS__X] = TO_TILE_SPACE(x) + SIGNED(lx) + 0.5f;
+        feature->pos[AXIS__Y] = (float) column->surface_heights[(lz * CHUNK_SIZE) + lx];
+        feature->pos[AXIS__Z] = TO_TILE_SPACE(z) + SIGNED(lz) + 0.5f;
+        feature->rot_y = M_PI * 2 * random_next_float(rand);
+    }
+
+    random_delete(rand);
+}
+
+static void plan_decoration_task(void* const arg, size_t const index) {
+    assert(arg != nullptr);
+
+    decoration_job_t const* const job = arg;
+    level_t const* const level = job->level;
+
+    pos_chunks_t const x = (pos_chunks_t) (index % level->size[AXIS__X]);
+    pos_chunks_t const z = (pos_chunks_t) (index / level->size[AXIS__X]);
+    plan_decoration(level, x, z, job->columns[index], &(job->chunks[index * level->size[AXIS__Y]]), &(job->decorations[index]));
+}
+
+static bool const plan_tree(pos_chunks_t const x, pos_chunks_t const z, column_t const* const column, chunk_t* const* const chunks, size_t const lx, size_t const lz, float pos[NUM_AXES]) {
+    assert(column != nullptr);
+    assert(chunks != nullptr);
+
+    size_t const height = column->surface_heights[(lz * CHUNK_SIZE) + lx];
+    if (height == 0) {
+        return false;
+    }
+
+    chunk_t const* const chunk = chunks[(height - 1) / CHUNK_SIZE];
+    size_t const pos_in_chunk[NUM_AXES] = { lx, (height - 1) % CHUNK_SIZE, lz };
+
+    if (chunk_get_tile(chunk, pos_in_chunk) != TILE__GRASS) {
+        return false;
+    }
+    float y_offset = 0.0f;
+    tile_shape_t const below_tile_shape = chunk_get_tile_shape(chunk, pos_in_chunk);
+    if (below_tile_shape == TILE_SHAPE__RAMP_NORTH || below_tile_shape == TILE_SHAPE__RAMP_SOUTH || below_tile_shape == TILE_SHAPE__RAMP_WEST || below_tile_shape == TILE_SHAPE__RAMP_EAST) {
+        y_offset = -0.5f;
+    }
+    if (below_tile_shape == TILE_SHAPE__CORNER_A_NORTH_WEST || below_tile_shape == TILE_SHAPE__CORNER_A_SOUTH_WEST || below_tile_shape == TILE_SHAPE__CORNER_A_NORTH_EAST || below_tile_shape == TILE_SHAPE__CORNER_A_SOUTH_EAST) {
+        y_offset = -1.0f;
+    }
+
+    pos[AXIS__X] = TO_TILE_SPACE(x) + SIGNED(lx) + 0.5f;
+    pos[AXIS__Y] = height + y_offset;
+    pos[AXIS__Z] = TO_TILE_SPACE(z) + SIGNED(lz) + 0.5f;
+
+    return true;
+}
+
+static void add_decoration(level_t* const self, decoration_t const* const decoration) {
+    assert(self != nullptr);
+    assert(decoration != nullptr);
+
+    for (size_t i = 0; i < decoration->num_features; i++) {
+        feature_t const* const feature = &(decoration->features[i]);
+        entity_t const entity = ecs_new_entity(self->ecs);
+        ecs_component_pos_t* const entity_pos = ecs_attach_component(self->ecs, entity, ECS_COMPONENT__POS);
+        memcpy(entity_pos->pos, feature->pos, sizeof(feature->pos));
+
+        switch (feature->type) {
+            case FEATURE_TYPE__TREE: {
+                ecs_component_sprite_t* const tree_sprite = ecs_attach_component(self->ecs, entity, ECS_COMPONENT__SPRITE);
+                tree_sprite->sprite = SPRITE__TREE;
+                tree_sprite->scale = 0.05f;
+                break;
+            }
+            case FEATURE_TYPE__MOB: {
+                ecs_component_rot_t* const mob_rot = ecs_attach_component(self->ecs, entity, ECS_COMPONENT__ROT);
+                ecs_component_aabb_t* const mob_aabb = ecs_attach_component(self->ecs, entity, ECS_COMPONENT__AABB);
+                ecs_attach_component(self->ecs, entity, ECS_COMPONENT__GRAVITY);
+                ecs_attach_component(self->ecs, entity, ECS_COMPONENT__VEL);
+                ecs_component_sprite_t* const mob_sprite = ecs_attach_component(self->ecs, entity, ECS_COMPONENT__SPRITE);
+                ecs_attach_component(self->ecs, entity, ECS_COMPONENT__MOVE_RANDOM);
+
+                mob_rot->rot[ROT_AXIS__Y] = feature->rot_y;
+
+                aabb_set_bounds(mob_aabb->aabb, (float[NUM_AXES]) { -0.4f, 0.0f, -0.4f }, (float[NUM_AXES]) { 0.4f, 1.8f, 0.4f });
+
+                mob_sprite->sprite = SPRITE__MOB;
+                mob_sprite->scale = 0.075f;
+                break;
+            }
+        }
+    }
+}
+
+static char* const get_cache_path(level_t const* const self, char const* const dir) {
+    assert(self != nullptr);
+    assert(dir != nullptr);
+
+    size_t const length = strlen(dir) + 128;
+    char* const path = malloc(length);
+    assert(path != nullptr);
+
+    snprintf(path, length, "%s/%" PRIu64 ".%zu.%zu.%zu.v%d", dir, self->seed, self->size[AXIS__X], self->size[AXIS__Y], self->size[AXIS__Z], LEVEL_GEN_VERSION);
+
+    return path;
+}
+
+// Fills chunks in the order generate_column_task expects them. If any chunk is missing or corrupt, nothing is kept and the terrain has to be generated.
+static bool const read_cache(level_t* const self, char const* const path, chunk_t** const chunks) {
+    assert(self != nullptr);
+    assert(path != nullptr);
+    assert(chunks != nullptr);
+
+    size_chunks_t const* const size = self->size;
+    size_t const num_regions_x = (size[AXIS__X] + REGION_SIZE - 1) / REGION_SIZE;
+    size_t const num_regions_z = (size[AXIS__Z] + REGION_SIZE - 1) / REGION_SIZE;
+    region_file_t** const regions = calloc(num_regions_x * num_regions_z, sizeof(region_file_t*));
+    assert(regions != nullptr);
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < num_regions_x * num_regions_z; i++) {
+        char* const region_path = get_region_path(path, (pos_chunks_t) (i % num_regions_x), (pos_chunks_t) (i / num_regions_x));
+        regions[i] = region_file_open(region_path);
+        ok = regions[i] != nullptr && region_file_get_height(regions[i]) == size[AXIS__Y];
+        free(region_path);
+    }
+    bool const has_regions = ok;
+
+    size_t num_read = 0;
+    for (size_t z = 0; ok && z < size[AXIS__Z]; z++) {
+        for (size_t x = 0; ok && x < size[AXIS__X]; x++) {
+            region_file_t const* const region = regions[((z / REGION_SIZE) * num_regions_x) + (x / REGION_SIZE)];
+            for (size_t y = 0; ok && y < size[AXIS__Y]; y++) {
+                size_t data_size;
+                uint8_t const* const data = region_file_get_chunk(region, (size_t[NUM_AXES]) { x % REGION_SIZE, y, z % REGION_SIZE }, &data_size);
+                chunk_t* const chunk = data != nullptr ? chunk_deserialize(data_size, data) : nullptr;
+
+                pos_chunks_t chunk_pos[NUM_AXES];
+                if (chunk != nullptr) {
+                    chunk_get_pos(chunk, chunk_pos);
+                }
+                ok = chunk != nullptr && chunk_pos[AXIS__X] == (pos_chunks_t) x && chunk_pos[AXIS__Y] == (pos_chunks_t) y && chunk_pos[AXIS__Z] == (pos_chunks_t) z;
+                if (ok) {
+                    chunk_map_put(self->chunks, (pos_chunks_t[NUM_AXES]) { (pos_chunks_t) x, (pos_chunks_t) y, (pos_chunks_t) z }, chunk);
+                    chunks[num_read++] = chunk;
+                } else if (chunk != nullptr) {
+                    chunk_delete(chunk);
+                }
+            }
+        }
+    }
+
+    if (!has_regions) {
+        LOG_DEBUG("level_t: no terrain cached at %s yet.", path);
+    } else if (!ok) {
+        LOG_ERROR("level_t: cached terrain at %s is corrupt, generating it.", path);
+    }
+    if (!ok) {
+        for (size_t i = 0; i < num_read; i++) {
+            pos_chunks_t chunk_pos[NUM_AXES];
+            chunk_get_pos(chunks[i], chunk_pos);
+            chunk_map_remove(self->chunks, chunk_pos);
+            chunk_delete(chunks[i]);
+        }
+    }
+
+    for (size_t i = 0; i < num_regions_x * num_regions_z; i++) {
+        if (regions[i] != nullptr) {
+            region_file_close(regions[i]);
+        }
+    }
+    free(regions);
+
+    return ok;
+}
+
+// Hands snapshots of the whole level to the saver, so the cache is written in the background. Regions replace their files whole,
+// so a cache cut short by a crash is missing regions rather than holding torn ones, and read_cache turns it down.
+static void write_cache(level_t* const self, char const* const dir, char const* const path) {
+    assert(self != nullptr);
+    assert(dir != nullptr);
+    assert(path != nullptr);
+
+    if (!region_file_make_dir(dir) || !region_file_make_dir(path)) {
+        return;
+    }
+    if (self->saver == nullptr) {
+        self->saver = level_saver_new();
+    }
+
+    size_chunks_t const* const size = self->size;
+    for (size_t region_z = 0; region_z * REGION_SIZE < size[AXIS__Z]; region_z++) {
+        for (size_t region_x = 0; region_x * REGION_SIZE < size[AXIS__X]; region_x++) {
+            chunk_t** const chunks = calloc(REGION_SIZE * size[AXIS__Y] * REGION_SIZE, sizeof(chunk_t*));
+            assert(chunks != nullptr);
+
+            for (size_t z = region_z * REGION_SIZE; z < size[AXIS__Z] && z < (region_z + 1) * REGION_SIZE; z++) {
+                for (size_t x = region_x * REGION_SIZE; x < size[AXIS__X] && x < (region_x + 1) * REGION_SIZE; x++) {
+                    for (size_t y = 0; y < size[AXIS__Y]; y++) {
+                        chunks[REGION_INDEX(x % REGION_SIZE, y, z % REGION_SIZE)] = chunk_snapshot(chunk_map_get(self->chunks, (pos_chunks_t[NUM_AXES]) { (pos_chunks_t) x, (pos_chunks_t) y, (pos_chunks_t) z }));
+                    }
+                }
+            }
+
+            char* const region_path = get_region_path(path, (pos_chunks_t) region_x, (pos_chunks_t) region_z);
+            level_saver_queue_region(self->saver, region_path, size[AXIS__Y], chunks);
+            free(region_path);
+        }
+    }
+    level_saver_queue_sync(self->saver, path);
+
+    LOG_DEBUG("level_t: queued terrain for caching at %s.", path);
+}
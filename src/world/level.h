@@ -9,35 +9,133 @@
 #include "src/util/random.h"
 
 #define NUM_TREES 500
+#define NUM_MOBS 100
+#define MAX_LEVEL_OBSERVERS 8
+#define LEVEL_JOURNAL_SIZE 1024
 
 typedef struct level level_t;
 
-level_t* const level_new(size_chunks_t const size[NUM_AXES]);
+typedef struct level_settings {
+    // A lazy level may pass 0 for X and Z to leave them unbounded, in which case positions may lie below zero.
+    size_chunks_t size[NUM_AXES];
+    uint64_t seed;
+    // When set, chunk columns are generated on first access or by the observer scheduler in level_tick instead of all up front.
+    bool lazy;
+    // Threads that generate and smooth an eager level, counting the calling thread. 0 uses one per CPU core. The result does not depend on it.
+    size_t num_threads;
+    // Directory of terrain cached by seed, size and generator version. An eager level whose terrain is cached there skips generating
+    // and smoothing it, and one whose terrain is not adds it. nullptr leaves the cache alone. Lazy levels do not use it.
+    char const* cache_path;
+} level_settings_t;
+
+// Where the time building an eager level went, in nanoseconds. All zero for a lazy level.
+typedef struct level_gen_stats {
+    size_t num_threads;
+    uint64_t total_ns;
+    // Wall-clock time of each stage. Generating covers shaping the terrain with noise and filling the chunks with it.
+    uint64_t generate_ns;
+    uint64_t smooth_ns;
+    uint64_t decorate_ns;
+    uint64_t spawn_ns;
+    // The generating stage split in two, summed over every thread. Noise covers the terrain shape and the caves.
+    uint64_t noise_cpu_ns;
+    uint64_t fill_cpu_ns;
+} level_gen_stats_t;
+
+typedef size_t level_observer_t;
+
+typedef struct level_change {
+    pos_chunks_t pos[NUM_AXES];
+    uint64_t generation;
+} level_change_t;
+
+// Walks between neighbouring tiles, only looking the chunk up again when a move leaves the current one.
+typedef struct level_cursor {
+    level_t const* level;
+    pos_tiles_t pos[NUM_AXES];
+    // nullptr while the cursor is outside the level.
+    chunk_t const* chunk;
+    size_t pos_in_chunk[NUM_AXES];
+} level_cursor_t;
+
+level_t* const level_new(level_settings_t const* const settings);
 
 void level_delete(level_t* const self);
 
+// Returns nullptr if no level is saved at the path. Saved chunks are decoded on first access, so the level is always lazy.
+level_t* const level_load(char const* const path);
+
+// Snapshots every chunk edited since the last save and writes them to the world directory on a background thread, creating it if needed.
+// Only fails if the directory cannot be set up. A loaded level can only be saved back to the directory it came from.
+bool const level_save(level_t* const self, char const* const path);
+
 uint64_t const level_get_seed(level_t const* const self);
 
+void level_get_gen_stats(level_t const* const self, level_gen_stats_t* const stats);
+
 void level_get_size(level_t const* const self, size_chunks_t size[NUM_AXES]);
 
-bool const level_is_tile_oob(level_t const* const self, size_t const pos[NUM_AXES]);
+bool const level_is_tile_oob(level_t const* const self, pos_tiles_t const pos[NUM_AXES]);
 
 random_t* const level_get_random(level_t* const self);
 
-bool const level_is_chunk_dirty(level_t const* const self, size_chunks_t const pos[NUM_AXES]);
+// Bumped on every chunk edit. Edits on a chunk face also bump the neighbour sharing it.
+uint64_t const level_get_generation(level_t const* const self);
+
+// The level generation of the last edit to this chunk, or 0 if it is untouched.
+uint64_t const level_get_chunk_generation(level_t const* const self, pos_chunks_t const pos[NUM_AXES]);
+
+// Copies up to max_changes chunk edits newer than *since, oldest first, and advances *since past them.
+// Sets *overflowed if some of those edits have already left the journal, in which case every chunk should be treated as changed.
+size_t const level_poll_changes(level_t const* const self, uint64_t* const since, level_change_t changes[], size_t const max_changes, bool* const overflowed);
+
+// Like everything else here, only safe on the thread that owns the level. Chunks stay put for the life of the level,
+// so the returned chunk may be handed to other threads and read there with chunk_read_snapshot.
+chunk_t* const level_get_chunk(level_t const* const self, pos_chunks_t const pos[NUM_AXES]);
+
+tile_t const level_get_tile(level_t const* const self, pos_tiles_t const pos[NUM_AXES]);
+
+void level_set_tile(level_t* const self, pos_tiles_t const pos[NUM_AXES], tile_t const tile);
+
+// Like level_set_tile, but also reshapes the tiles around the edit so that it keeps the smoothed look of the terrain.
+void level_set_tile_smoothed(level_t* const self, pos_tiles_t const pos[NUM_AXES], tile_t const tile);
+
+tile_shape_t const level_get_tile_shape(level_t const* const self, pos_tiles_t const pos[NUM_AXES]);
 
-chunk_t* const level_get_chunk(level_t const* const self, size_chunks_t const pos[NUM_AXES]);
+void level_set_tile_shape(level_t* const self, pos_tiles_t const pos[NUM_AXES], tile_shape_t const shape);
 
-tile_t const level_get_tile(level_t const* const self, size_t const pos[NUM_AXES]);
+// Buffers cover the box [min, max) with X varying fastest, then Z, then Y. Either buffer may be nullptr.
+// Reading outside a bounded level yields air.
+void level_read_region(level_t const* const self, pos_tiles_t const min[NUM_AXES], pos_tiles_t const max[NUM_AXES], tile_t* const tiles, tile_shape_t* const shapes);
 
-void level_set_tile(level_t* const self, size_t const pos[NUM_AXES], tile_t const tile);
+void level_write_region(level_t* const self, pos_tiles_t const min[NUM_AXES], pos_tiles_t const max[NUM_AXES], tile_t const* const tiles, tile_shape_t const* const shapes);
 
-tile_shape_t const level_get_tile_shape(level_t const* const self, size_t const pos[NUM_AXES]);
+// One above the highest non-air tile at (x, z), or 0 if the whole tile column is air. Kept up to date on every edit.
+size_t const level_get_surface_height(level_t const* const self, pos_tiles_t const x, pos_tiles_t const z);
 
-void level_set_tile_shape(level_t* const self, size_t const pos[NUM_AXES], tile_shape_t const shape);
+// Copies the surface heights of a whole chunk column, indexed by local Z then X.
+void level_get_surface_heights(level_t const* const self, pos_chunks_t const x, pos_chunks_t const z, uint32_t heights[CHUNK_SIZE * CHUNK_SIZE]);
+
+void level_cursor_init(level_cursor_t* const self, level_t const* const level, pos_tiles_t const pos[NUM_AXES]);
+
+void level_cursor_move(level_cursor_t* const self, side_t const side);
+
+void level_cursor_move_by(level_cursor_t* const self, int const offsets[NUM_AXES]);
+
+bool const level_cursor_is_oob(level_cursor_t const* const self);
+
+tile_t const level_cursor_get_tile(level_cursor_t const* const self);
+
+tile_shape_t const level_cursor_get_tile_shape(level_cursor_t const* const self);
 
 void level_tick(level_t* const self);
 
+level_observer_t const level_add_observer(level_t* const self, float const pos[NUM_AXES], size_chunks_t const radius);
+
+void level_move_observer(level_t* const self, level_observer_t const observer, float const pos[NUM_AXES]);
+
+void level_remove_observer(level_t* const self, level_observer_t const observer);
+
 ecs_t* const level_get_ecs(level_t* const self);
 
 float const level_get_nearest_face_on_axis(level_t const* const self, float const pos[NUM_AXES], side_t const side, float const max_range);
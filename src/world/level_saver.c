@@ -0,0 +1,244 @@
+#include "./level_saver.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "src/util/logger.h"
+#include "src/util/object_counter.h"
+#include "src/util/util.h"
+#include "src/world/region_file.h"
+
+/* THREADING:
+ *     The owning thread only ever queues jobs and collects finished ones,
+ *     each under a short lock. The saver thread serializes and writes jobs
+ *     in queue order, so a region queued twice sees the first write when it
+ *     fills in chunks the second one does not carry. Finished jobs are
+ *     handed back rather than freed, because their snapshots have to be
+ *     deleted on the thread that took them.
+ */
+
+typedef struct save_job save_job_t;
+
+struct save_job {
+    save_job_t* next;
+    char* path;
+    size_chunks_t height;
+    // nullptr for a directory sync.
+    chunk_t** chunks;
+};
+
+struct level_saver {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    save_job_t* queue_head;
+    save_job_t* queue_tail;
+    save_job_t* done;
+    bool is_stopping;
+};
+
+static void* run(void* const arg);
+static void queue_job(level_saver_t* const self, save_job_t* const job);
+static void write_region(save_job_t const* const job);
+
+level_saver_t* const level_saver_new(void) {
+    level_saver_t* const self = malloc(sizeof(level_saver_t));
+    assert(self != nullptr);
+
+    pthread_mutex_init(&(self->lock), nullptr);
+    pthread_cond_init(&(self->cond), nullptr);
+    self->queue_head = nullptr;
+    self->queue_tail = nullptr;
+    self->done = nullptr;
+    self->is_stopping = false;
+
+    int const result = pthread_create(&(self->thread), nullptr, run, self);
+    assert(result == 0);
+
+    OBJ_CTR_INC(level_saver_t);
+
+    return self;
+}
+
+void level_saver_delete(level_saver_t* const self) {
+    assert(self != nullptr);
+
+    pthread_mutex_lock(&(self->lock));
+    self->is_stopping = true;
+    pthread_cond_signal(&(self->cond));
+    pthread_mutex_unlock(&(self->lock));
+
+    pthread_join(self->thread, nullptr);
+
+    level_saver_collect(self);
+    assert(self->queue_head == nullptr);
+
+    pthread_cond_destroy(&(self->cond));
+    pthread_mutex_destroy(&(self->lock));
+
+    free(self);
+
+    OBJ_CTR_DEC(level_saver_t);
+}
+
+void level_saver_queue_region(level_saver_t* const self, char const* const path, size_chunks_t const height, chunk_t** const chunks) {
+    assert(self != nullptr);
+    assert(path != nullptr);
+    assert(chunks != nullptr);
+
+    save_job_t* const job = malloc(sizeof(save_job_t));
+    assert(job != nullptr);
+
+    job->path = strcata(path, "");
+    job->height = height;
+    job->chunks = chunks;
+
+    queue_job(self, job);
+}
+
+void level_saver_queue_sync(level_saver_t* const self, char const* const dir) {
+    assert(self != nullptr);
+    assert(dir != nullptr);
+
+    save_job_t* const job = malloc(sizeof(save_job_t));
+    assert(job != nullptr);
+
+    job->path = strcata(dir, "");
+    job->height = 0;
+    job->chunks = nullptr;
+
+    queue_job(self, job);
+}
+
+void level_saver_collect(level_saver_t* const self) {
+    assert(self != nullptr);
+
+    pthread_mutex_lock(&(self->lock));
+    save_job_t* job = self->done;
+    self->done = nullptr;
+    pthread_mutex_unlock(&(self->lock));
+
+    while (job != nullptr) {
+        save_job_t* const next = job->next;
+
+        if (job->chunks != nullptr) {
+            size_t const num_chunks = REGION_SIZE * job->height * REGION_SIZE;
+            for (size_t i = 0; i < num_chunks; i++) {
+                if (job->chunks[i] != nullptr) {
+                    chunk_delete(job->chunks[i]);
+                }
+            }
+            free(job->chunks);
+        }
+        free(job->path);
+        free(job);
+
+        job = next;
+    }
+}
+
+static void* run(void* const arg) {
+    level_saver_t* const self = arg;
+
+    pthread_mutex_lock(&(self->lock));
+    while (true) {
+        while (self->queue_head == nullptr && !self->is_stopping) {
+            pthread_cond_wait(&(self->cond), &(self->lock));
+        }
+        save_job_t* const job = self->queue_head;
+        if (job == nullptr) {
+            break;
+        }
+        self->queue_head = job->next;
+        if (self->queue_head == nullptr) {
+            self->queue_tail = nullptr;
+        }
+        pthread_mutex_unlock(&(self->lock));
+
+        if (job->chunks != nullptr) {
+            write_region(job);
+        } else {
+            region_file_sync_dir(job->path);
+        }
+
+        pthread_mutex_lock(&(self->lock));
+        job->next = self->done;
+        self->done = job;
+    }
+    pthread_mutex_unlock(&(self->lock));
+
+    return nullptr;
+}
+
+static void queue_job(level_saver_t* const self, save_job_t* const job) {
+    job->next = nullptr;
+
+    pthread_mutex_lock(&(self->lock));
+    if (self->queue_tail != nullptr) {
+        self->queue_tail->next = job;
+    } else {
+        self->queue_head = job;
+    }
+    self->queue_tail = job;
+    pthread_cond_signal(&(self->cond));
+    pthread_mutex_unlock(&(self->lock));
+}
+
+static void write_region(save_job_t const* const job) {
+    uint64_t const start_time = get_time_ms();
+
+    size_t const num_entries = REGION_SIZE * job->height * REGION_SIZE;
+
+    region_entry_t* const entries = calloc(num_entries, sizeof(region_entry_t));
+    assert(entries != nullptr);
+
+    region_file_t* old_region = region_file_open(job->path);
+    if (old_region != nullptr && region_file_get_height(old_region) != job->height) {
+        LOG_ERROR("level_saver_t: replacing %s, which has a different height.", job->path);
+        region_file_close(old_region);
+        old_region = nullptr;
+    }
+
+    // Serialized sizes are only known afterwards, so chunks go through a scratch buffer of the worst-case size.
+    size_t num_written = 0;
+    uint8_t* scratch = nullptr;
+    for (size_t i = 0; i < num_entries; i++) {
+        chunk_t const* const chunk = job->chunks[i];
+        if (chunk != nullptr) {
+            if (scratch == nullptr) {
+                scratch = malloc(chunk_serialize(chunk, nullptr));
+                assert(scratch != nullptr);
+            }
+            size_t const size = chunk_serialize(chunk, scratch);
+            uint8_t* const data = malloc(size);
+            assert(data != nullptr);
+            memcpy(data, scratch, size);
+            entries[i].data = data;
+            entries[i].size = size;
+            num_written++;
+        } else if (old_region != nullptr) {
+            size_t const pos[NUM_AXES] = { i % REGION_SIZE, i / (REGION_SIZE * REGION_SIZE), (i / REGION_SIZE) % REGION_SIZE };
+            entries[i].data = region_file_get_chunk(old_region, pos, &(entries[i].size));
+        }
+    }
+
+    free(scratch);
+
+    region_file_write(job->path, job->height, entries);
+
+    for (size_t i = 0; i < num_entries; i++) {
+        if (job->chunks[i] != nullptr) {
+            free((void*) entries[i].data);
+        }
+    }
+    free(entries);
+
+    if (old_region != nullptr) {
+        region_file_close(old_region);
+    }
+
+    uint64_t const end_time = get_time_ms();
+    LOG_DEBUG("level_saver_t: wrote %zu chunks to %s in %lums.", num_written, job->path, end_time - start_time);
+}
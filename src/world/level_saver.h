@@ -0,0 +1,21 @@
+#pragma once
+
+#include "src/world/chunk.h"
+
+typedef struct level_saver level_saver_t;
+
+// Starts a background thread that writes queued regions in order.
+level_saver_t* const level_saver_new(void);
+
+// Finishes every queued save before returning.
+void level_saver_delete(level_saver_t* const self);
+
+// Takes over chunks, an array of REGION_SIZE * height * REGION_SIZE chunk snapshots in REGION_INDEX order.
+// Null entries keep whatever the region file already holds once earlier queued saves are written.
+void level_saver_queue_region(level_saver_t* const self, char const* const path, size_chunks_t const height, chunk_t** const chunks);
+
+// Syncs the directory once every region queued before it is written.
+void level_saver_queue_sync(level_saver_t* const self, char const* const dir);
+
+// Deletes the snapshots of written regions. Snapshots have to be deleted on the thread that took them, so call this from it.
+void level_saver_collect(level_saver_t* const self);
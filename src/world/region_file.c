@@ -0,0 +1,315 @@
+// Needed for open, fstat and mmap under strict C.
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include "./region_file.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "src/util/logger.h"
+#include "src/util/object_counter.h"
+#include "src/util/util.h"
+
+#define REGION_MAGIC 0x4e474552 // "REGN"
+#define REGION_VERSION 1
+#define HEADER_SIZE 16
+#define TABLE_ENTRY_SIZE 16
+
+/* FILE FORMAT:
+ *     All fields are little-endian.
+ *
+ *     4 bytes magic
+ *     4 bytes version
+ *     4 bytes height, in chunks
+ *     4 bytes reserved
+ *     REGION_SIZE * height * REGION_SIZE table entries, in REGION_INDEX order:
+ *         8 bytes offset of the chunk from the start of the file
+ *         8 bytes size of the chunk, or 0 if the region does not hold it
+ *     Serialized chunks (see chunk_serialize), back to back.
+ *
+ *     Files are mapped rather than read, so chunks nobody asks for are never
+ *     paged in.
+ */
+
+struct region_file {
+    uint8_t const* data;
+    size_t size;
+    size_chunks_t height;
+};
+
+static uint8_t const* const map_file(char const* const path, size_t* const size);
+static void unmap_file(uint8_t const* const data, size_t const size);
+static uint32_t const read_u32(uint8_t const* const data);
+static uint64_t const read_u64(uint8_t const* const data);
+static void write_u32(uint8_t* const data, uint32_t const value);
+static void write_u64(uint8_t* const data, uint64_t const value);
+
+region_file_t* const region_file_open(char const* const path) {
+    assert(path != nullptr);
+
+    size_t size;
+    uint8_t const* const data = map_file(path, &size);
+    if (data == nullptr) {
+        return nullptr;
+    }
+
+    if (size < HEADER_SIZE || read_u32(&(data[0])) != REGION_MAGIC || read_u32(&(data[4])) != REGION_VERSION) {
+        LOG_ERROR("region_file_t: %s is not a valid region file.", path);
+        unmap_file(data, size);
+        return nullptr;
+    }
+
+    size_chunks_t const height = read_u32(&(data[8]));
+    if (height == 0 || size < HEADER_SIZE + (REGION_SIZE * height * REGION_SIZE * TABLE_ENTRY_SIZE)) {
+        LOG_ERROR("region_file_t: %s has a truncated chunk table.", path);
+        unmap_file(data, size);
+        return nullptr;
+    }
+
+    region_file_t* const self = malloc(sizeof(region_file_t));
+    assert(self != nullptr);
+
+    self->data = data;
+    self->size = size;
+    self->height = height;
+
+    OBJ_CTR_INC(region_file_t);
+
+    return self;
+}
+
+void region_file_close(region_file_t* const self) {
+    assert(self != nullptr);
+
+    unmap_file(self->data, self->size);
+
+    free(self);
+
+    OBJ_CTR_DEC(region_file_t);
+}
+
+size_chunks_t const region_file_get_height(region_file_t const* const self) {
+    assert(self != nullptr);
+
+    return self->height;
+}
+
+uint8_t const* const region_file_get_chunk(region_file_t const* const self, size_t const pos[NUM_AXES], size_t* const size) {
+    assert(self != nullptr);
+    assert(pos[AXIS__X] < REGION_SIZE && pos[AXIS__Y] < self->height && pos[AXIS__Z] < REGION_SIZE);
+    assert(size != nullptr);
+
+    uint8_t const* const entry = &(self->data[HEADER_SIZE + (REGION_INDEX(pos[AXIS__X], pos[AXIS__Y], pos[AXIS__Z]) * TABLE_ENTRY_SIZE)]);
+    uint64_t const offset = read_u64(&(entry[0]));
+    uint64_t const chunk_size = read_u64(&(entry[8]));
+
+    if (chunk_size == 0) {
+        return nullptr;
+    }
+    if (offset > self->size || chunk_size > self->size - offset) {
+        LOG_ERROR("region_file_t: chunk [%zu, %zu, %zu] lies outside the file.", pos[AXIS__X], pos[AXIS__Y], pos[AXIS__Z]);
+        return nullptr;
+    }
+
+    *size = (size_t) chunk_size;
+
+    return &(self->data[offset]);
+}
+
+bool const region_file_write(char const* const path, size_chunks_t const height, region_entry_t const entries[]) {
+    assert(path != nullptr);
+    assert(height > 0);
+    assert(entries != nullptr);
+
+    size_t const num_entries = REGION_SIZE * height * REGION_SIZE;
+    size_t const table_size = HEADER_SIZE + (num_entries * TABLE_ENTRY_SIZE);
+
+    uint8_t* const table = calloc(table_size, 1);
+    assert(table != nullptr);
+
+    write_u32(&(table[0]), REGION_MAGIC);
+    write_u32(&(table[4]), REGION_VERSION);
+    write_u32(&(table[8]), (uint32_t) height);
+
+    size_t offset = table_size;
+    for (size_t i = 0; i < num_entries; i++) {
+        if (entries[i].data == nullptr) {
+            continue;
+        }
+        write_u64(&(table[HEADER_SIZE + (i * TABLE_ENTRY_SIZE)]), offset);
+        write_u64(&(table[HEADER_SIZE + (i * TABLE_ENTRY_SIZE) + 8]), entries[i].size);
+        offset += entries[i].size;
+    }
+
+    char* const temp_path = strcata(path, ".tmp");
+
+    FILE* const file = fopen(temp_path, "wb");
+    if (file == nullptr) {
+        LOG_ERROR("region_file_t: failed to open %s for writing.", temp_path);
+        free(temp_path);
+        free(table);
+        return false;
+    }
+
+    bool ok = fwrite(table, 1, table_size, file) == table_size;
+    for (size_t i = 0; ok && i < num_entries; i++) {
+        if (entries[i].data != nullptr) {
+            ok = fwrite(entries[i].data, 1, entries[i].size, file) == entries[i].size;
+        }
+    }
+    // Make sure the data is on disk before the rename can expose it.
+    ok = ok && fflush(file) == 0;
+#if defined(_WIN32)
+    ok = ok && _commit(_fileno(file)) == 0;
+#else
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = (fclose(file) == 0) && ok;
+    free(table);
+
+#if defined(_WIN32)
+    // rename does not replace existing files on Windows.
+    if (ok) {
+        remove(path);
+    }
+#endif
+    if (ok) {
+        ok = rename(temp_path, path) == 0;
+    }
+    if (!ok) {
+        LOG_ERROR("region_file_t: failed to write %s.", path);
+        remove(temp_path);
+    }
+
+    free(temp_path);
+
+    return ok;
+}
+
+bool const region_file_make_dir(char const* const path) {
+    assert(path != nullptr);
+
+#if defined(_WIN32)
+    int const result = _mkdir(path);
+#else
+    int const result = mkdir(path, 0755);
+#endif
+
+    if (result != 0 && errno != EEXIST) {
+        LOG_ERROR("region_file_t: failed to create directory %s.", path);
+        return false;
+    }
+
+    return true;
+}
+
+void region_file_sync_dir(char const* const path) {
+    assert(path != nullptr);
+
+#if !defined(_WIN32)
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR("region_file_t: failed to open directory %s.", path);
+        return;
+    }
+    if (fsync(fd) != 0) {
+        LOG_ERROR("region_file_t: failed to sync directory %s.", path);
+    }
+    close(fd);
+#endif
+}
+
+static uint8_t const* const map_file(char const* const path, size_t* const size) {
+#if defined(_WIN32)
+    FILE* const file = fopen(path, "rb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+    fseek(file, 0, SEEK_END);
+    long const length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (length <= 0) {
+        fclose(file);
+        return nullptr;
+    }
+
+    uint8_t* const data = malloc((size_t) length);
+    assert(data != nullptr);
+    if (fread(data, 1, (size_t) length, file) != (size_t) length) {
+        free(data);
+        fclose(file);
+        return nullptr;
+    }
+    fclose(file);
+
+    *size = (size_t) length;
+
+    return data;
+#else
+    int const fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    // The mapping stays valid after the descriptor is closed, and after the file is renamed over.
+    void* const data = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return nullptr;
+    }
+
+    *size = (size_t) st.st_size;
+
+    return data;
+#endif
+}
+
+static void unmap_file(uint8_t const* const data, size_t const size) {
+#if defined(_WIN32)
+    (void) size;
+    free((void*) data);
+#else
+    munmap((void*) data, size);
+#endif
+}
+
+static uint32_t const read_u32(uint8_t const* const data) {
+    return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static uint64_t const read_u64(uint8_t const* const data) {
+    return (uint64_t) read_u32(data) | ((uint64_t) read_u32(&(data[4])) << 32);
+}
+
+static void write_u32(uint8_t* const data, uint32_t const value) {
+    data[0] = (uint8_t) value;
+    data[1] = (uint8_t) (value >> 8);
+    data[2] = (uint8_t) (value >> 16);
+    data[3] = (uint8_t) (value >> 24);
+}
+
+static void write_u64(uint8_t* const data, uint64_t const value) {
+    write_u32(data, (uint32_t) value);
+    write_u32(&(data[4]), (uint32_t) (value >> 32));
+}
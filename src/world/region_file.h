@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/world/chunk.h"
+#include "src/world/side.h"
+
+// Chunk columns along each horizontal side of a region.
+#define REGION_SIZE 16
+
+// Region coordinate holding a signed chunk coordinate, rounding towards negative infinity.
+#define REGION_COORD(chunk_coord) (((chunk_coord) >= 0 ? (chunk_coord) : (chunk_coord) - (REGION_SIZE - 1)) / REGION_SIZE)
+
+// Index of a chunk within a region, from its position local to the region.
+#define REGION_INDEX(x, y, z) ((((y) * REGION_SIZE) + (z)) * REGION_SIZE + (x))
+
+typedef struct region_file region_file_t;
+
+typedef struct region_entry {
+    uint8_t const* data;
+    size_t size;
+} region_entry_t;
+
+// Returns nullptr if there is no valid region file at the path.
+region_file_t* const region_file_open(char const* const path);
+
+void region_file_close(region_file_t* const self);
+
+size_chunks_t const region_file_get_height(region_file_t const* const self);
+
+// Returns the serialized chunk at a position local to the region, or nullptr if the region does not hold it.
+uint8_t const* const region_file_get_chunk(region_file_t const* const self, size_t const pos[NUM_AXES], size_t* const size);
+
+// Takes REGION_SIZE * height * REGION_SIZE entries in REGION_INDEX order; entries with nullptr data are left out.
+// The file is written and synced beside the path, then renamed over it, so readers never see a partial region.
+// The rename itself is only durable once the directory is synced.
+bool const region_file_write(char const* const path, size_chunks_t const height, region_entry_t const entries[]);
+
+// Creates the directory if it does not exist yet.
+bool const region_file_make_dir(char const* const path);
+
+// Makes renames within the directory durable. Syncing once after a batch of writes saves a sync per file.
+void region_file_sync_dir(char const* const path);